@@ -0,0 +1,780 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+//#include "cvkstart.h"
+#include "cvkstart.c"
+#include "mock_vulkan.h"
+
+// Benchmarks running `cvkstart` against the stand-in driver of `mock_vulkan.c`
+// Usage : bench [benchmark names...], runs all of them if none is given
+
+uint64_t
+_bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int
+_bench_compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Sorts the samples and gets a percentile
+ */
+uint64_t
+_bench_percentile(uint64_t *samples, uint64_t count, double percentile)
+{
+    qsort(samples, count, sizeof(uint64_t), _bench_compare_u64);
+    uint64_t index = (uint64_t)(percentile / 100.0 * (double)(count - 1) );
+    return samples[index];
+}
+
+// ## Queue submission
+
+#define _BENCH_SUBMITS_PER_THREAD 20000
+#define _BENCH_SUBMIT_COST_NS     2000
+
+typedef struct
+{
+    vs_queue          *queue;
+    pthread_mutex_t   *mutex;      // Only for the locked baseline
+    uint64_t          *submit_times;
+    _Atomic uint64_t  *next_slot;  // Only for the locked baseline
+} _bench_producer_args;
+
+void *
+_bench_ring_producer(void *arg)
+{
+    _bench_producer_args *args   = arg;
+    VkSubmitInfo2         submit = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
+    for(uint32_t i = 0; i < _BENCH_SUBMITS_PER_THREAD; i++)
+    {
+        uint64_t start  = _bench_now_ns();
+        uint64_t ticket = 0;
+        while( !vs_queue_submit(args->queue, &submit, VK_NULL_HANDLE, &ticket) )
+        {
+            sched_yield();
+            start = _bench_now_ns();
+        }
+        args->submit_times[ticket - 1] = start;
+    }
+    return NULL;
+}
+
+void *
+_bench_locked_producer(void *arg)
+{
+    _bench_producer_args *args   = arg;
+    VkSubmitInfo2         submit = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
+    for(uint32_t i = 0; i < _BENCH_SUBMITS_PER_THREAD; i++)
+    {
+        uint64_t start = _bench_now_ns();
+        pthread_mutex_lock(args->mutex);
+        vkQueueSubmit2(args->queue->vk_queue, 1, &submit, VK_NULL_HANDLE);
+        pthread_mutex_unlock(args->mutex);
+
+        // Latency until the submission reached the driver
+        uint64_t slot = atomic_fetch_add(args->next_slot, 1);
+        args->submit_times[slot] = _bench_now_ns() - start;
+    }
+    return NULL;
+}
+
+void
+_bench_report(const char *mode, uint32_t thread_count, uint64_t total, uint64_t elapsed_ns, uint64_t *latencies)
+{
+    uint64_t p50  = _bench_percentile(latencies, total, 50.0);
+    uint64_t p99  = _bench_percentile(latencies, total, 99.0);
+    uint64_t p999 = _bench_percentile(latencies, total, 99.9);
+    printf("%-8s %3u threads : %10.0f submits/s, %6.2f submits/call, latency p50 %8.2f us, p99 %8.2f us, p99.9 %8.2f us\n",
+           mode, thread_count, (double)total / ( (double)elapsed_ns / 1e9 ),
+           (double)vs_mock_submit_stats_get()->submit_infos / (double)vs_mock_submit_stats_get()->submit_calls,
+           p50 / 1e3, p99 / 1e3, p999 / 1e3);
+}
+
+void
+bench_queue_submission(void)
+{
+    static vs_queue queue;
+    uint32_t        thread_counts[] = { 1, 2, 4, 8, 16, 32 };
+
+    for(uint32_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++)
+    {
+        uint32_t  thread_count = thread_counts[t];
+        uint64_t  total        = (uint64_t)thread_count * _BENCH_SUBMITS_PER_THREAD;
+        uint64_t *submit_times = malloc(sizeof(uint64_t) * total);
+        uint64_t *latencies    = malloc(sizeof(uint64_t) * total);
+        pthread_t producers[32];
+        _bench_producer_args args;
+
+        // Ring : producers push, this thread drains
+        vs_mock_reset();
+        vs_mock_set_submit_cost(_BENCH_SUBMIT_COST_NS);
+        VkDevice device = (VkDevice)(uintptr_t)0x1u;
+        VkQueue  vk_queue;
+        vkGetDeviceQueue(device, 0, 0, &vk_queue);
+        vs_queue_init(&queue, device, vk_queue);
+        args = (_bench_producer_args){ .queue = &queue, .submit_times = submit_times };
+
+        uint64_t start = _bench_now_ns();
+        for(uint32_t i = 0; i < thread_count; i++)
+        {
+            pthread_create(&producers[i], NULL, _bench_ring_producer, &args);
+        }
+
+        uint64_t drained = 0;
+        while(drained < total)
+        {
+            uint32_t count = 0;
+            vs_queue_drain(&queue, &count);
+            if(count == 0)
+            {
+                sched_yield();
+                continue;
+            }
+
+            // Producers write their submit time after pushing, so latencies are computed once they are joined
+            uint64_t now = _bench_now_ns();
+            for(uint64_t i = drained; i < drained + count; i++)
+            {
+                latencies[i] = now;
+            }
+            drained += count;
+        }
+        uint64_t elapsed = _bench_now_ns() - start;
+        for(uint32_t i = 0; i < thread_count; i++)
+        {
+            pthread_join(producers[i], NULL);
+        }
+
+        // Latency until the submission reached the driver
+        for(uint64_t i = 0; i < total; i++)
+        {
+            latencies[i] = latencies[i] > submit_times[i] ? latencies[i] - submit_times[i] : 0;
+        }
+        _bench_report("ring", thread_count, total, elapsed, latencies);
+
+        // Baseline : every producer submits itself under a mutex
+        pthread_mutex_t  mutex     = PTHREAD_MUTEX_INITIALIZER;
+        _Atomic uint64_t next_slot = 0;
+        vs_mock_reset();
+        vs_mock_set_submit_cost(_BENCH_SUBMIT_COST_NS);
+        args = (_bench_producer_args){ .queue = &queue, .mutex = &mutex, .submit_times = latencies, .next_slot = &next_slot };
+
+        start = _bench_now_ns();
+        for(uint32_t i = 0; i < thread_count; i++)
+        {
+            pthread_create(&producers[i], NULL, _bench_locked_producer, &args);
+        }
+        for(uint32_t i = 0; i < thread_count; i++)
+        {
+            pthread_join(producers[i], NULL);
+        }
+        elapsed = _bench_now_ns() - start;
+        _bench_report("mutex", thread_count, total, elapsed, latencies);
+
+        free(submit_times);
+        free(latencies);
+    }
+}
+
+// ## Dispatch
+
+#define _BENCH_DISPATCH_CALLS 20000000
+
+void
+_bench_dispatch_report(const char *command, const char *mode, uint64_t elapsed_ns)
+{
+    printf("%-16s %-7s : %12.0f calls/s, %6.2f ns/call\n",
+           command, mode, (double)_BENCH_DISPATCH_CALLS / ( (double)elapsed_ns / 1e9 ), (double)elapsed_ns / _BENCH_DISPATCH_CALLS);
+}
+
+void
+bench_dispatch(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance );
+
+    vs_device_dispatch dispatch;
+    VkQueue            queue;
+    vs_queue_request   request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    VkDevice           device  = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_dispatch = &dispatch },
+        instance
+        );
+
+    VkCommandPool               pool;
+    VkCommandBuffer             cmd;
+    VkCommandPoolCreateInfo     pool_ci  = { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    VkCommandBufferAllocateInfo alloc_ci = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, .commandBufferCount = 1 };
+    dispatch.vkCreateCommandPool(device, &pool_ci, NULL, &pool);
+    alloc_ci.commandPool = pool;
+    dispatch.vkAllocateCommandBuffers(device, &alloc_ci, &cmd);
+
+    // vkCmdDraw
+    uint64_t start = _bench_now_ns();
+    for(uint32_t i = 0; i < _BENCH_DISPATCH_CALLS; i++)
+    {
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+    }
+    _bench_dispatch_report("vkCmdDraw", "loader", _bench_now_ns() - start);
+
+    start = _bench_now_ns();
+    for(uint32_t i = 0; i < _BENCH_DISPATCH_CALLS; i++)
+    {
+        dispatch.vkCmdDraw(cmd, 3, 1, 0, 0);
+    }
+    _bench_dispatch_report("vkCmdDraw", "table", _bench_now_ns() - start);
+
+    // vkGetFenceStatus, a typical polling call
+    start = _bench_now_ns();
+    for(uint32_t i = 0; i < _BENCH_DISPATCH_CALLS; i++)
+    {
+        vkGetFenceStatus(device, VK_NULL_HANDLE);
+    }
+    _bench_dispatch_report("vkGetFenceStatus", "loader", _bench_now_ns() - start);
+
+    start = _bench_now_ns();
+    for(uint32_t i = 0; i < _BENCH_DISPATCH_CALLS; i++)
+    {
+        dispatch.vkGetFenceStatus(device, VK_NULL_HANDLE);
+    }
+    _bench_dispatch_report("vkGetFenceStatus", "table", _bench_now_ns() - start);
+
+    dispatch.vkDestroyCommandPool(device, pool, NULL);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+}
+
+// ## Memory arena
+
+#define _BENCH_ARENA_OPERATIONS     200000
+#define _BENCH_ARENA_LIVE           8192
+#define _BENCH_ALLOCATION_COST_NS   2000
+#define _BENCH_LINEAR_ALLOCATIONS   20000000
+
+/**
+ * @brief A xorshift generator, so both allocators see the same sequence
+ */
+uint64_t
+_bench_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * @brief Sizes from 256 B to 4 MiB, uniform in log scale, as resources are
+ */
+VkDeviceSize
+_bench_random_size(uint64_t *state)
+{
+    uint32_t log2 = 8 + (uint32_t)(_bench_random(state) % 14);
+    return (1ull << log2) + _bench_random(state) % (1ull << log2);
+}
+
+void
+_bench_arena_stress(const char *mode, vs_memory_arena *arena, VkDevice device)
+{
+    vs_memory_allocation *live      = calloc(_BENCH_ARENA_LIVE, sizeof(vs_memory_allocation) );
+    uint64_t             *latencies = malloc(sizeof(uint64_t) * _BENCH_ARENA_OPERATIONS);
+    uint64_t              state     = 0x9E3779B97F4A7C15ull;
+    uint64_t              failures  = 0;
+
+    uint64_t start = _bench_now_ns();
+    for(uint32_t i = 0; i < _BENCH_ARENA_OPERATIONS; i++)
+    {
+        vs_memory_allocation *slot = &live[_bench_random(&state) % _BENCH_ARENA_LIVE];
+        VkDeviceSize          size = _bench_random_size(&state);
+        uint64_t              op   = _bench_now_ns();
+        if(slot->memory != VK_NULL_HANDLE)
+        {
+            if(arena)
+            {
+                vs_memory_arena_free(arena, slot);
+            }
+            else
+            {
+                vkFreeMemory(device, slot->memory, NULL);
+                slot->memory = VK_NULL_HANDLE;
+            }
+        }
+        else if(arena)
+        {
+            vs_memory_request request = { .requirements = { .size = size, .alignment = 256, .memoryTypeBits = ~0u } };
+            failures += !vs_memory_arena_allocate(arena, &request, slot);
+        }
+        else
+        {
+            VkMemoryAllocateInfo info = { .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, .allocationSize = size };
+            failures += vkAllocateMemory(device, &info, NULL, &slot->memory) != VK_SUCCESS;
+        }
+        latencies[i] = _bench_now_ns() - op;
+    }
+    uint64_t elapsed = _bench_now_ns() - start;
+
+    // Fragmentation : the part of the free memory that cannot serve an allocation as large as all of it
+    double fragmentation = 0.0;
+    if(arena)
+    {
+        vs_memory_arena_stats stats;
+        vs_memory_arena_stats_get(arena, &stats);
+        VkDeviceSize free_bytes = stats.block_bytes - stats.used_bytes;
+        fragmentation = free_bytes ? 1.0 - (double)stats.largest_free_range / (double)free_bytes : 0.0;
+    }
+
+    uint64_t p50 = _bench_percentile(latencies, _BENCH_ARENA_OPERATIONS, 50.0);
+    uint64_t p99 = _bench_percentile(latencies, _BENCH_ARENA_OPERATIONS, 99.0);
+    printf("%-7s : %10.0f ops/s, latency p50 %8.2f us, p99 %8.2f us, %6lu failures, %5lu vkAllocateMemory, fragmentation %5.1f %%\n",
+           mode, (double)_BENCH_ARENA_OPERATIONS / ( (double)elapsed / 1e9 ), p50 / 1e3, p99 / 1e3, failures,
+           vs_mock_memory_stats_get()->allocate_calls, fragmentation * 100.0);
+
+    for(uint32_t i = 0; i < _BENCH_ARENA_LIVE && !arena; i++)
+    {
+        vkFreeMemory(device, live[i].memory, NULL);
+    }
+    free(live);
+    free(latencies);
+}
+
+void
+bench_memory_arena(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance );
+
+    VkQueue          queue;
+    vs_queue_request request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    vs_memory_arena  arena;
+    VkDevice         device  = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_memory_arena = &arena },
+        instance
+        );
+    vs_mock_set_allocation_cost(_BENCH_ALLOCATION_COST_NS);
+
+    // Random allocations and frees, with up to twice the allocation count limit live
+    _bench_arena_stress("arena", &arena, device);
+    vs_memory_policy     policy     = arena.policy;
+    vs_memory_arena_info arena_info = arena.info;
+    vs_memory_arena_destroy(&arena);
+    vs_memory_arena_init(&arena, device, &policy, NULL, arena_info);
+    _bench_arena_stress("direct", NULL, device);
+
+    // Per frame allocations from a ring
+    vs_memory_linear     linear;
+    vs_memory_allocation range;
+    vs_memory_linear_init(&arena, VS_MEMORY_USAGE_UPLOAD, 16ull << 20, true, &linear);
+    uint64_t start = _bench_now_ns();
+    for(uint32_t i = 0; i < _BENCH_LINEAR_ALLOCATIONS; i++)
+    {
+        if( !vs_memory_linear_allocate(&linear, 64 + (i & 255), 16, &range) )
+        {
+            vs_memory_linear_release(&linear, vs_memory_linear_mark(&linear) );
+        }
+    }
+    uint64_t elapsed = _bench_now_ns() - start;
+    printf("linear  : %10.0f allocations/s, %6.2f ns/allocation\n",
+           (double)_BENCH_LINEAR_ALLOCATIONS / ( (double)elapsed / 1e9 ), (double)elapsed / _BENCH_LINEAR_ALLOCATIONS);
+    vs_memory_linear_destroy(&arena, &linear);
+
+    vs_memory_arena_destroy(&arena);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+}
+
+// ## Upload ring
+
+#define _BENCH_UPLOAD_BYTES     (256ull << 20)
+#define _BENCH_UPLOAD_SUBMIT_NS 2000
+
+void
+_bench_upload(const char *mode, vs_upload_ring *ring, VkBuffer buffer, const uint8_t *data, VkDeviceSize upload_size, uint32_t uploads_per_flush)
+{
+    uint64_t flushes = ring->stats.flushes;
+    uint64_t count   = _BENCH_UPLOAD_BYTES / upload_size;
+    uint64_t start   = _bench_now_ns();
+    for(uint64_t i = 0; i < count; i++)
+    {
+        VkDeviceSize offset = (i * upload_size) % (4ull << 20);
+        if( !vs_upload_ring_buffer(ring, buffer, offset, data, upload_size) )
+        {
+            // The ring is full of this batch
+            vs_upload_ring_flush(ring, NULL);
+            vs_upload_ring_buffer(ring, buffer, offset, data, upload_size);
+        }
+        if( (i + 1) % uploads_per_flush == 0 )
+        {
+            vs_upload_ring_flush(ring, NULL);
+        }
+    }
+    vs_upload_ring_flush(ring, NULL);
+    uint64_t elapsed = _bench_now_ns() - start;
+    double   seconds = (double)elapsed / 1e9;
+    printf("%-24s: %8.0f MB/s, %10.0f uploads/s, %7lu flushes\n",
+           mode, (double)_BENCH_UPLOAD_BYTES / 1e6 / seconds, (double)count / seconds, ring->stats.flushes - flushes);
+}
+
+void
+bench_upload_ring(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance );
+
+    VkQueue             graphics_queue, transfer_queue;
+    vs_queue_assignment assignments[2];
+    vs_queue_request    requests[] =
+    {
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &graphics_queue },
+        { .required_flags = VK_QUEUE_TRANSFER_BIT, .destination = &transfer_queue },
+    };
+    vs_memory_arena arena;
+    VkDevice        device = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 2, .queue_requests = requests, .out_assignments = assignments, .out_memory_arena = &arena },
+        instance
+        );
+    vs_mock_set_submit_cost(_BENCH_UPLOAD_SUBMIT_NS);
+
+    vs_upload_ring ring;
+    vs_upload_ring_init(&ring, &arena, (vs_upload_ring_info){
+        .queue                 = transfer_queue,
+        .queue_family_index    = assignments[1].family_index,
+        .consumer_family_index = assignments[0].family_index,
+    });
+
+    VkBuffer             buffer;
+    VkBufferCreateInfo   buffer_create_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = 8ull << 20 };
+    vs_memory_request    request            = { .requirements = { .size = 8ull << 20, .alignment = 256, .memoryTypeBits = ~0u } };
+    vs_memory_allocation allocation;
+    vkCreateBuffer(device, &buffer_create_info, NULL, &buffer);
+    vs_memory_arena_allocate(&arena, &request, &allocation);
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+
+    uint8_t *data = malloc(1 << 20);
+    memset(data, 0x5a, 1 << 20);
+    _bench_upload("1 KiB, flush each",  &ring, buffer, data, 1 << 10, 1);
+    _bench_upload("1 KiB, batched",     &ring, buffer, data, 1 << 10, 4096);
+    _bench_upload("1 MiB, flush each",  &ring, buffer, data, 1 << 20, 1);
+    _bench_upload("1 MiB, batched",     &ring, buffer, data, 1 << 20, 16);
+    free(data);
+
+    vs_upload_ring_destroy(&ring);
+    vkDestroyBuffer(device, buffer, NULL);
+    vs_memory_arena_free(&arena, &allocation);
+    vs_mock_set_submit_cost(0);
+    vs_memory_arena_destroy(&arena);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+}
+
+// ## Streaming loader
+
+#define _BENCH_STREAM_BYTES (128ull << 20)
+#define _BENCH_STREAM_PATH  "/tmp/cvkstart_bench_stream.bin"
+
+void
+_bench_stream(const char *mode, vs_upload_ring *ring, VkBuffer buffer, bool io_uring, bool direct_io)
+{
+    vs_stream_loader loader;
+    vs_stream_file   file;
+    if( !vs_stream_loader_init(&loader, ring, (vs_stream_loader_info){ .direct_io = direct_io, .disable_io_uring = !io_uring }) )
+    {
+        return;
+    }
+    if(loader.io_uring != io_uring || !vs_stream_file_open(&loader, _BENCH_STREAM_PATH, &file) || file.direct != direct_io)
+    {
+        printf("%-24s: unavailable\n", mode);
+        vs_stream_loader_destroy(&loader);
+        return;
+    }
+
+    // The file is streamed to the same 8 MiB of the buffer over and over
+    uint64_t start = _bench_now_ns();
+    for(uint64_t offset = 0; offset < _BENCH_STREAM_BYTES; offset += 8ull << 20)
+    {
+        vs_stream_loader_read(&loader, &file, offset, 8ull << 20, buffer, 0);
+    }
+    bool     loaded  = vs_stream_loader_finish(&loader, NULL);
+    uint64_t elapsed = _bench_now_ns() - start;
+    printf("%-24s: %8.0f MB/s, %5.1f average depth, %5lu reads%s\n",
+           mode, (double)loader.stats.bytes / 1e6 / ( (double)elapsed / 1e9 ),
+           (double)loader.stats.depth_sum / (double)VS_MAX(loader.stats.depth_samples, 1), loader.stats.reads, loaded ? "" : ", failed");
+    vs_stream_file_close(&file);
+    vs_stream_loader_destroy(&loader);
+}
+
+void
+bench_stream_loader(void)
+{
+    FILE    *f     = fopen(_BENCH_STREAM_PATH, "wb");
+    uint8_t *data  = malloc(1 << 20);
+    memset(data, 0x5a, 1 << 20);
+    for(uint32_t i = 0; f && i < _BENCH_STREAM_BYTES >> 20; i++)
+    {
+        fwrite(data, 1, 1 << 20, f);
+    }
+    free(data);
+    if(f == NULL || fclose(f) != 0)
+    {
+        printf("cannot write %s\n", _BENCH_STREAM_PATH);
+        return;
+    }
+
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance );
+
+    VkQueue             queue;
+    vs_queue_assignment assignment;
+    vs_queue_request    request = { .required_flags = VK_QUEUE_TRANSFER_BIT, .destination = &queue };
+    vs_memory_arena     arena;
+    VkDevice            device  = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_assignments = &assignment, .out_memory_arena = &arena },
+        instance
+        );
+    vs_mock_set_submit_cost(_BENCH_UPLOAD_SUBMIT_NS);
+
+    vs_upload_ring ring;
+    vs_upload_ring_init(&ring, &arena, (vs_upload_ring_info){ .queue = queue, .queue_family_index = assignment.family_index });
+
+    VkBuffer             buffer;
+    VkBufferCreateInfo   buffer_create_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = 8ull << 20 };
+    vs_memory_request    memory_request     = { .requirements = { .size = 8ull << 20, .alignment = 256, .memoryTypeBits = ~0u } };
+    vs_memory_allocation allocation;
+    vkCreateBuffer(device, &buffer_create_info, NULL, &buffer);
+    vs_memory_arena_allocate(&arena, &memory_request, &allocation);
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+
+    // Buffered reads come from the page cache the file was just written to, direct reads from the disk
+    _bench_stream("threads, buffered",  &ring, buffer, false, false);
+    _bench_stream("io_uring, buffered", &ring, buffer, true,  false);
+    _bench_stream("threads, direct",    &ring, buffer, false, true);
+    _bench_stream("io_uring, direct",   &ring, buffer, true,  true);
+
+    vs_upload_ring_destroy(&ring);
+    vkDestroyBuffer(device, buffer, NULL);
+    vs_memory_arena_free(&arena, &allocation);
+    vs_mock_set_submit_cost(0);
+    vs_memory_arena_destroy(&arena);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    unlink(_BENCH_STREAM_PATH);
+}
+
+// ## Command pools
+
+#define _BENCH_POOL_FRAMES             2000
+#define _BENCH_POOL_BUFFERS_PER_FRAME  32
+#define _BENCH_POOL_COMMAND_COST_NS    300
+
+typedef struct
+{
+    VkDevice                device;
+    pthread_barrier_t      *frame_barrier;
+
+    // Shared pool, guarded by the mutex
+    VkCommandPool           pool;
+    pthread_mutex_t        *mutex;
+
+    // Pool set, advanced by the first thread between two frames
+    vs_command_pool_set    *set;
+} _bench_pool_args;
+
+void
+_bench_record(VkCommandBuffer command_buffer)
+{
+    VkCommandBufferBeginInfo begin_info = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    vkEndCommandBuffer(command_buffer);
+}
+
+void *
+_bench_shared_pool_recorder(void *arg)
+{
+    _bench_pool_args           *args          = arg;
+    VkCommandBuffer             command_buffers[_BENCH_POOL_BUFFERS_PER_FRAME];
+    VkCommandBufferAllocateInfo allocate_info =
+    {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool        = args->pool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    for(uint32_t frame = 0; frame < _BENCH_POOL_FRAMES; frame++)
+    {
+        for(uint32_t i = 0; i < _BENCH_POOL_BUFFERS_PER_FRAME; i++)
+        {
+            pthread_mutex_lock(args->mutex);
+            vkAllocateCommandBuffers(args->device, &allocate_info, &command_buffers[i]);
+            pthread_mutex_unlock(args->mutex);
+            _bench_record(command_buffers[i]);
+        }
+
+        // Freed once the frame completed, as applications keep them until then
+        pthread_mutex_lock(args->mutex);
+        vkFreeCommandBuffers(args->device, args->pool, _BENCH_POOL_BUFFERS_PER_FRAME, command_buffers);
+        pthread_mutex_unlock(args->mutex);
+        pthread_barrier_wait(args->frame_barrier);
+    }
+    return NULL;
+}
+
+void *
+_bench_pool_set_recorder(void *arg)
+{
+    _bench_pool_args *args         = arg;
+    uint32_t          thread_index = vs_command_pool_set_register_thread(args->set);
+    for(uint32_t frame = 0; frame < _BENCH_POOL_FRAMES; frame++)
+    {
+        for(uint32_t i = 0; i < _BENCH_POOL_BUFFERS_PER_FRAME; i++)
+        {
+            _bench_record(vs_command_pool_set_allocate(args->set, thread_index, VK_COMMAND_BUFFER_LEVEL_PRIMARY) );
+        }
+
+        // No thread records while the frame advances
+        if(pthread_barrier_wait(args->frame_barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+        {
+            vs_command_pool_set_advance(args->set);
+        }
+        pthread_barrier_wait(args->frame_barrier);
+    }
+    return NULL;
+}
+
+void
+_bench_pools(const char *mode, _bench_pool_args *args, uint32_t thread_count, void *(*recorder)(void *) )
+{
+    pthread_t         threads[16];
+    pthread_barrier_t frame_barrier;
+    pthread_barrier_init(&frame_barrier, NULL, thread_count);
+    args->frame_barrier = &frame_barrier;
+
+    uint64_t calls = vs_mock_command_stats_get()->allocate_calls + vs_mock_command_stats_get()->pool_resets;
+    uint64_t start = _bench_now_ns();
+    for(uint32_t i = 0; i < thread_count; i++)
+    {
+        pthread_create(&threads[i], NULL, recorder, args);
+    }
+    for(uint32_t i = 0; i < thread_count; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = _bench_now_ns() - start;
+    pthread_barrier_destroy(&frame_barrier);
+
+    uint64_t total = (uint64_t)thread_count * _BENCH_POOL_FRAMES * _BENCH_POOL_BUFFERS_PER_FRAME;
+    calls = vs_mock_command_stats_get()->allocate_calls + vs_mock_command_stats_get()->pool_resets - calls;
+    printf("%-12s %2u threads : %10.0f command buffers/s, %6.3f allocations and resets per command buffer\n",
+           mode, thread_count, (double)total / ( (double)elapsed / 1e9 ), (double)calls / (double)total);
+}
+
+void
+bench_command_pools(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance );
+
+    VkQueue             queue;
+    vs_queue_assignment assignment;
+    vs_queue_request    request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    VkDevice            device  = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_assignments = &assignment },
+        instance
+        );
+    vs_mock_set_command_buffer_cost(_BENCH_POOL_COMMAND_COST_NS);
+
+    uint32_t thread_counts[] = { 1, 4, 16 };
+    for(uint32_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++)
+    {
+        pthread_mutex_t         mutex = PTHREAD_MUTEX_INITIALIZER;
+        VkCommandPoolCreateInfo pool_create_info =
+        {
+            .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = assignment.family_index,
+        };
+        _bench_pool_args args = { .device = device, .mutex = &mutex };
+        vkCreateCommandPool(device, &pool_create_info, NULL, &args.pool);
+        _bench_pools("shared pool", &args, thread_counts[t], _bench_shared_pool_recorder);
+        vkDestroyCommandPool(device, args.pool, NULL);
+
+        vs_command_pool_set set;
+        vs_command_pool_set_init(&set, (vs_command_pool_set_info){ .device = device, .queue_family_index = assignment.family_index, .thread_count = thread_counts[t] });
+        args.set = &set;
+        _bench_pools("pool set", &args, thread_counts[t], _bench_pool_set_recorder);
+        vs_command_pool_set_destroy(&set);
+    }
+
+    vs_mock_set_command_buffer_cost(0);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+}
+
+// ## Runner
+
+typedef struct
+{
+    const char   *name;
+    void (*func)(void);
+} benchmark;
+
+#define BENCHMARK(f) { #f, f }
+
+static const benchmark benchmarks[] =
+{
+    BENCHMARK(bench_queue_submission),
+    BENCHMARK(bench_dispatch),
+    BENCHMARK(bench_memory_arena),
+    BENCHMARK(bench_upload_ring),
+    BENCHMARK(bench_stream_loader),
+    BENCHMARK(bench_command_pools),
+};
+
+int
+main(int argc, char **argv)
+{
+    for(uint32_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+    {
+        bool selected = argc <= 1;
+        for(int j = 1; j < argc; j++)
+        {
+            selected |= strcmp(argv[j], benchmarks[i].name) == 0;
+        }
+
+        if(selected)
+        {
+            printf("## %s\n", benchmarks[i].name);
+            benchmarks[i].func();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dlfcn.h>
+//#include "cvkstart.h"
+#include "cvkstart.c"
+#include "mock_vulkan.h"
+
+// Benchmarks of instance creation, physical device selection, device creation and format queries at scale, built in
+// the meta loader mode (`VS_LOADER`) against the stand-in driver built as a shared library, which doubles as an ICD.
+// Usage : bench_icd <path to the stand-in driver> [--icd <manifest>] [scenario names...]
+// With `--icd`, commands go through the system Vulkan loader, pointed to the manifest with `VK_DRIVER_FILES`.
+
+uint64_t
+_bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int
+_bench_compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// ## Stand-in driver
+
+static void                      (*_bench_mock_reset)(void);
+static vs_mock_physical_device *(*_bench_mock_add_physical_device)(const char *, VkPhysicalDeviceType);
+
+/**
+ * @brief Opens the stand-in driver to configure it, the loader (or `vs_loader_init`) then gets the same instance of it
+ */
+bool
+_bench_mock_open(const char *path)
+{
+    void *library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(library == NULL)
+    {
+        return false;
+    }
+    _bench_mock_reset               = (void (*)(void))(uintptr_t)dlsym(library, "vs_mock_reset");
+    _bench_mock_add_physical_device = (vs_mock_physical_device *(*)(const char *, VkPhysicalDeviceType))(uintptr_t)dlsym(library, "vs_mock_add_physical_device");
+    return _bench_mock_reset != NULL && _bench_mock_add_physical_device != NULL;
+}
+
+#define _BENCH_MAX_EXTENSIONS 4096
+
+static char        _bench_extension_names[_BENCH_MAX_EXTENSIONS][VK_MAX_EXTENSION_NAME_SIZE];
+static const char *_bench_extensions[_BENCH_MAX_EXTENSIONS];
+
+// Required by the selector, they come last in the extension lists of the devices
+static char *_bench_required_extensions[] =
+{
+    "VK_KHR_swapchain",
+    "VK_EXT_memory_budget",
+    "VK_KHR_push_descriptor",
+};
+
+#define _BENCH_REQUIRED_EXTENSION_COUNT (uint32_t)( sizeof(_bench_required_extensions) / sizeof(_bench_required_extensions[0]) )
+
+typedef enum
+{
+    BENCH_QUEUES_DESKTOP,    // The default layout of the mock : universal, compute and transfer families
+    BENCH_QUEUES_SINGLE,     // A single universal family with a single queue
+    BENCH_QUEUES_FRAGMENTED, // 16 small families with rotating capabilities
+} bench_queue_layout;
+
+typedef enum
+{
+    BENCH_FEATURES_NONE,     // Nothing is required
+    BENCH_FEATURES_MODERN,   // Core, 1.2 and 1.3 features are required, devices with an odd index lack some of them
+} bench_feature_set;
+
+typedef struct
+{
+    const char           *name;
+    uint32_t              device_count;
+    uint32_t              extension_count;
+    bench_queue_layout    queue_layout;
+    bench_feature_set     feature_set;
+    uint32_t              iterations;
+} bench_scenario;
+
+void
+_bench_mock_setup(const bench_scenario *scenario)
+{
+    // Filler extensions first, so that the required ones are found at the end of the lists
+    uint32_t filler_count = scenario->extension_count - _BENCH_REQUIRED_EXTENSION_COUNT;
+    for(uint32_t i = 0; i < scenario->extension_count; i++)
+    {
+        if(i < filler_count)
+        {
+            snprintf(_bench_extension_names[i], VK_MAX_EXTENSION_NAME_SIZE, "VK_MOCK_synthetic_extension_%u", i);
+        }
+        else
+        {
+            snprintf(_bench_extension_names[i], VK_MAX_EXTENSION_NAME_SIZE, "%s", _bench_required_extensions[i - filler_count]);
+        }
+        _bench_extensions[i] = _bench_extension_names[i];
+    }
+
+    _bench_mock_reset();
+    for(uint32_t d = 0; d < scenario->device_count; d++)
+    {
+        // Only the last device is discrete, so that the selector cannot stop early
+        char name[64];
+        snprintf(name, sizeof(name), "Mock GPU %u", d);
+        bool                     last = d == scenario->device_count - 1;
+        vs_mock_physical_device *dev  = _bench_mock_add_physical_device(name, last ? VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU : VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU);
+        dev->extension_count = scenario->extension_count;
+        dev->extensions      = _bench_extensions;
+        dev->memory_properties.memoryHeaps[0].size = (1ull + d % 8) << 30;
+
+        switch(scenario->queue_layout)
+        {
+        case BENCH_QUEUES_DESKTOP:
+            break;
+        case BENCH_QUEUES_SINGLE:
+            dev->queue_family_count           = 1;
+            dev->queue_families[0].queueCount = 1;
+            break;
+        case BENCH_QUEUES_FRAGMENTED:
+            dev->queue_family_count = VS_MOCK_MAX_QUEUE_FAMILIES;
+            for(uint32_t f = 0; f < VS_MOCK_MAX_QUEUE_FAMILIES; f++)
+            {
+                static const VkQueueFlags flags[] =
+                {
+                    VK_QUEUE_TRANSFER_BIT,
+                    VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT,
+                    VK_QUEUE_SPARSE_BINDING_BIT,
+                    VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT,
+                };
+                dev->queue_families[f] = (VkQueueFamilyProperties)
+                {
+                    .queueFlags         = flags[f % 4],
+                    .queueCount         = 1 + f % 4,
+                    .timestampValidBits = 64,
+                };
+                dev->present_support[f] = f == VS_MOCK_MAX_QUEUE_FAMILIES - 1;
+            }
+            break;
+        }
+
+        if(scenario->feature_set == BENCH_FEATURES_MODERN)
+        {
+            dev->features.samplerAnisotropy     = VK_TRUE;
+            dev->features.multiDrawIndirect     = VK_TRUE;
+            dev->features_12.timelineSemaphore   = VK_TRUE;
+            dev->features_12.bufferDeviceAddress = VK_TRUE;
+            dev->features_13.dynamicRendering    = VK_TRUE;
+            dev->features_13.synchronization2    = d % 2 == 0 || last;
+        }
+    }
+}
+
+// ## Measurements
+
+typedef enum
+{
+    BENCH_STEP_INSTANCE_BUILD,
+    BENCH_STEP_SELECTION,
+    BENCH_STEP_DEVICE_CREATE,
+    BENCH_STEP_FORMAT_QUERIES,
+    BENCH_STEP_FORMAT_TABLE_BUILD,
+    BENCH_STEP_FORMAT_TABLE_QUERIES,
+    BENCH_STEP_COUNT,
+} bench_step;
+
+static const char *_bench_step_names[BENCH_STEP_COUNT] =
+{
+    "vs_instance_builder_build",
+    "vs_select_physical_device",
+    "vs_device_create",
+    "format queries",
+    "vs_format_table_build",
+    "format table queries",
+};
+
+static VkFormat _bench_depth_formats[] =
+{
+    VK_FORMAT_D32_SFLOAT_S8_UINT,
+    VK_FORMAT_D24_UNORM_S8_UINT,
+    VK_FORMAT_D32_SFLOAT,
+};
+
+/**
+ * @brief Runs `iterations` times the whole startup, timing each step
+ *
+ * @return Wether or not every iteration succeeded
+ */
+bool
+_bench_run(const bench_scenario *scenario, uint64_t *samples[BENCH_STEP_COUNT])
+{
+    // Every core format
+    VkFormat all_formats[VK_FORMAT_ASTC_12x12_SRGB_BLOCK];
+    VkFormat sampled_formats[VK_FORMAT_ASTC_12x12_SRGB_BLOCK];
+    for(uint32_t i = 0; i < VK_FORMAT_ASTC_12x12_SRGB_BLOCK; i++)
+    {
+        all_formats[i] = (VkFormat)(i + 1);
+    }
+
+    for(uint32_t it = 0; it < scenario->iterations; it++)
+    {
+        uint64_t start = _bench_now_ns();
+        vs_instance instance;
+        if( !vs_instance_builder_build( (vs_instance_builder){ .app_name = "bench_icd" }, &instance ) )
+        {
+            return false;
+        }
+        samples[BENCH_STEP_INSTANCE_BUILD][it] = _bench_now_ns() - start;
+
+        VkQueue          queues[3];
+        vs_queue_request requests[3] =
+        {
+            { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queues[0] },
+            { .required_flags = VK_QUEUE_COMPUTE_BIT, .destination = &queues[1] },
+            { .required_flags = VK_QUEUE_TRANSFER_BIT, .destination = &queues[2] },
+        };
+        uint32_t                    request_count = scenario->queue_layout == BENCH_QUEUES_SINGLE ? 1 : 3;
+        vs_physical_device_selector selector      =
+        {
+            .minimum_version          = VK_API_VERSION_1_3,
+            .required_queue_count     = request_count,
+            .required_queues          = requests,
+            .allow_shared_queues      = true,
+            .required_extension_count = _BENCH_REQUIRED_EXTENSION_COUNT,
+            .required_extensions      = _bench_required_extensions,
+            .preferred_type           = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
+        };
+        if(scenario->feature_set == BENCH_FEATURES_MODERN)
+        {
+            selector.required_features.samplerAnisotropy     = VK_TRUE;
+            selector.required_features.multiDrawIndirect     = VK_TRUE;
+            selector.required_features_12.timelineSemaphore   = VK_TRUE;
+            selector.required_features_12.bufferDeviceAddress = VK_TRUE;
+            selector.required_features_13.dynamicRendering    = VK_TRUE;
+            selector.required_features_13.synchronization2    = VK_TRUE;
+        }
+
+        start = _bench_now_ns();
+        VkPhysicalDevice physical_device = vs_select_physical_device(selector, instance);
+        samples[BENCH_STEP_SELECTION][it] = _bench_now_ns() - start;
+        if(physical_device == VK_NULL_HANDLE)
+        {
+            return false;
+        }
+
+        vs_device_builder device_builder =
+        {
+            .queue_request_count    = request_count,
+            .queue_requests         = requests,
+            .features               = selector.required_features,
+            .features_11            = selector.required_features_11,
+            .features_12            = selector.required_features_12,
+            .features_13            = selector.required_features_13,
+            .enable_extension_count = _BENCH_REQUIRED_EXTENSION_COUNT,
+            .enable_extensions      = _bench_required_extensions,
+        };
+        start = _bench_now_ns();
+        VkDevice device = vs_device_create(physical_device, device_builder, instance);
+        samples[BENCH_STEP_DEVICE_CREATE][it] = _bench_now_ns() - start;
+        if(device == VK_NULL_HANDLE)
+        {
+            return false;
+        }
+
+        // A depth format lookup and a scan of every core format, as done when creating render targets
+        start = _bench_now_ns();
+        VkFormat depth = vs_format_query_format(
+            physical_device,
+            (vs_format_query){ .required_optimal_tiling_features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT },
+            (vs_format_set){ .format_count = sizeof(_bench_depth_formats) / sizeof(_bench_depth_formats[0]), .formats = _bench_depth_formats }
+            );
+        uint32_t sampled_count = 0;
+        vs_format_query_formats(
+            physical_device,
+            (vs_format_query){ .required_optimal_tiling_features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT },
+            (vs_format_set){ .format_count = VK_FORMAT_ASTC_12x12_SRGB_BLOCK, .formats = all_formats },
+            &sampled_count,
+            sampled_formats
+            );
+        samples[BENCH_STEP_FORMAT_QUERIES][it] = _bench_now_ns() - start;
+        if(depth == VK_FORMAT_UNDEFINED || sampled_count == 0)
+        {
+            return false;
+        }
+
+        // The same queries, answered from the table
+        static vs_format_table table;
+        start = _bench_now_ns();
+        vs_format_table_build(physical_device, VK_API_VERSION_1_3, 0, NULL, &table);
+        samples[BENCH_STEP_FORMAT_TABLE_BUILD][it] = _bench_now_ns() - start;
+
+        start = _bench_now_ns();
+        depth = vs_format_table_query_format(
+            &table,
+            (vs_format_query){ .required_optimal_tiling_features = VK_FORMAT_FEATURE_2_DEPTH_STENCIL_ATTACHMENT_BIT },
+            (vs_format_set){ .format_count = sizeof(_bench_depth_formats) / sizeof(_bench_depth_formats[0]), .formats = _bench_depth_formats }
+            );
+        vs_format_table_query_formats(
+            &table,
+            (vs_format_query){ .required_optimal_tiling_features = VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_BIT },
+            (vs_format_set){ .format_count = VK_FORMAT_ASTC_12x12_SRGB_BLOCK, .formats = all_formats },
+            &sampled_count,
+            sampled_formats
+            );
+        samples[BENCH_STEP_FORMAT_TABLE_QUERIES][it] = _bench_now_ns() - start;
+        if(depth == VK_FORMAT_UNDEFINED || sampled_count == 0)
+        {
+            return false;
+        }
+
+        vs_device_destroy(device, instance);
+        vs_instance_destroy(instance);
+    }
+    return true;
+}
+
+void
+_bench_report(const char *step, uint64_t *samples, uint32_t count)
+{
+    qsort(samples, count, sizeof(uint64_t), _bench_compare_u64);
+    printf("    %-26s : p50 %10.2f us, p90 %10.2f us, p99 %10.2f us, max %10.2f us\n",
+           step,
+           samples[(count - 1) * 50 / 100] / 1e3,
+           samples[(count - 1) * 90 / 100] / 1e3,
+           samples[(count - 1) * 99 / 100] / 1e3,
+           samples[count - 1] / 1e3);
+}
+
+// ## Runner
+
+static const bench_scenario scenarios[] =
+{
+    { "single",       1,  16,   BENCH_QUEUES_SINGLE,     BENCH_FEATURES_NONE,   1000 },
+    { "desktop",      4,  256,  BENCH_QUEUES_DESKTOP,    BENCH_FEATURES_MODERN, 500  },
+    { "fragmented",   16, 256,  BENCH_QUEUES_FRAGMENTED, BENCH_FEATURES_MODERN, 200  },
+    { "farm",         64, 256,  BENCH_QUEUES_DESKTOP,    BENCH_FEATURES_MODERN, 100  },
+    { "extensions",   4,  4096, BENCH_QUEUES_DESKTOP,    BENCH_FEATURES_NONE,   100  },
+    { "worst",        64, 2048, BENCH_QUEUES_FRAGMENTED, BENCH_FEATURES_MODERN, 20   },
+};
+
+int
+main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        printf("Usage : %s <path to the stand-in driver> [--icd <manifest>] [scenario names...]\n", argv[0]);
+        return 1;
+    }
+
+    int         first_scenario = 2;
+    const char *manifest       = NULL;
+    if(argc >= 4 && strcmp(argv[2], "--icd") == 0)
+    {
+        manifest       = argv[3];
+        first_scenario = 4;
+    }
+
+    if( !_bench_mock_open(argv[1]) )
+    {
+        printf("Could not open the stand-in driver %s\n", argv[1]);
+        return 1;
+    }
+
+    if(manifest)
+    {
+        // Older loaders only know of VK_ICD_FILENAMES
+        setenv("VK_DRIVER_FILES", manifest, 1);
+        setenv("VK_ICD_FILENAMES", manifest, 1);
+    }
+    if( !vs_loader_init(manifest ? NULL : argv[1]) )
+    {
+        printf("Could not load %s\n", manifest ? "the system Vulkan loader" : argv[1]);
+        return 1;
+    }
+
+    for(uint32_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        bool selected = argc <= first_scenario;
+        for(int j = first_scenario; j < argc; j++)
+        {
+            selected |= strcmp(argv[j], scenarios[i].name) == 0;
+        }
+        if( !selected )
+        {
+            continue;
+        }
+
+        const bench_scenario *scenario = &scenarios[i];
+        printf("## %s : %u devices, %u extensions, %u iterations\n",
+               scenario->name, scenario->device_count, scenario->extension_count, scenario->iterations);
+
+        _bench_mock_setup(scenario);
+        uint64_t *samples[BENCH_STEP_COUNT];
+        for(uint32_t s = 0; s < BENCH_STEP_COUNT; s++)
+        {
+            samples[s] = malloc(sizeof(uint64_t) * scenario->iterations);
+        }
+
+        bool ok = _bench_run(scenario, samples);
+        for(uint32_t s = 0; ok && s < BENCH_STEP_COUNT; s++)
+        {
+            _bench_report(_bench_step_names[s], samples[s], scenario->iterations);
+        }
+        if( !ok )
+        {
+            printf("    failed\n");
+        }
+
+        for(uint32_t s = 0; s < BENCH_STEP_COUNT; s++)
+        {
+            free(samples[s]);
+        }
+        if( !ok )
+        {
+            return 1;
+        }
+    }
+
+    vs_loader_terminate();
+    return 0;
+}
@@ -37,14 +37,506 @@
 #ifndef __CVKSTART_H__
 #define __CVKSTART_H__
 
+// In meta loader mode (see `vs_loader_init`), the Vulkan commands are function pointers resolved at runtime
+#ifdef VS_LOADER
+#ifndef VK_NO_PROTOTYPES
+#define VK_NO_PROTOTYPES
+#endif
+#endif
+
 #include <vulkan/vulkan.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
 
 #define VS_DEBUG_UTILS_MESSAGE_TYPE_ALL \
         VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | \
         VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | \
         VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT
 
+// ### NAME SETS
+
+/**
+ * @brief The number of slots to give to a name set of `name_count` names
+ */
+#define VS_NAME_SET_SLOT_COUNT(name_count) ( (name_count) * 2 + 1 )
+
+/**
+ * @brief A hash set of names (extensions, layers ...) used to answer support queries without quadratic scans
+ * @note The set does not own any memory : it refers to the names where they already are (e.g. in an array of
+ *       `VkExtensionProperties`), and to slots provided by the user, so building it allocates nothing.
+ */
+typedef struct
+{
+    /**
+     * @brief Pointer to the first name, the i-th name is at `names + i * name_stride`
+     */
+    const char        *names;
+    size_t             name_stride;
+    uint32_t           name_count;
+
+    /**
+     * @brief Open addressing table, holding the index + 1 of the name of each slot, 0 for empty slots
+     */
+    const uint16_t    *slots;
+    uint32_t           slot_count;
+} vs_name_set;
+
+/**
+ * @brief Builds a name set
+ *
+ * @param[out] set The set to build
+ * @param names Pointer to the first name
+ * @param name_stride The number of bytes between two names (e.g. `sizeof(VkExtensionProperties)`)
+ * @param name_count The number of names, at most 65534
+ * @param slots Storage for the slots, must be able to hold `VS_NAME_SET_SLOT_COUNT(name_count)` elements and outlive the set
+ */
+void     vs_name_set_build(vs_name_set *set, const char *names, size_t name_stride, uint32_t name_count, uint16_t *slots);
+
+/**
+ * @brief Checks if a name is in a set
+ */
+bool     vs_name_set_contains(const vs_name_set *set, const char *name);
+
+/**
+ * @brief Finds the names which are not in a set
+ *
+ * @param set The set
+ * @param name_count The number of names to look for
+ * @param names The names to look for
+ * @param[out] out_missing Where to write the missing names (can be NULL, can hold `name_count` elements)
+ * @return The number of missing names
+ */
+uint32_t vs_name_set_missing(const vs_name_set *set, uint32_t name_count, char **names, char **out_missing);
+
+// ### DISPATCH
+
+/*
+ * Command lists, as `X(command)` entries, used to declare and to load the dispatch tables. Commands that were promoted
+ * to core are also looked up with their `KHR` then `EXT` suffix, so a table is filled on older devices exposing the
+ * extension.
+ */
+
+#define VS_GLOBAL_COMMANDS(X) \
+        X(vkEnumerateInstanceVersion) \
+        X(vkEnumerateInstanceExtensionProperties) \
+        X(vkEnumerateInstanceLayerProperties) \
+        X(vkCreateInstance)
+
+#define VS_INSTANCE_COMMANDS(X) \
+        X(vkDestroyInstance) \
+        X(vkEnumeratePhysicalDevices) \
+        X(vkGetPhysicalDeviceProperties) \
+        X(vkGetPhysicalDeviceProperties2) \
+        X(vkGetPhysicalDeviceFeatures) \
+        X(vkGetPhysicalDeviceFeatures2) \
+        X(vkGetPhysicalDeviceMemoryProperties) \
+        X(vkGetPhysicalDeviceMemoryProperties2) \
+        X(vkGetPhysicalDeviceQueueFamilyProperties) \
+        X(vkGetPhysicalDeviceFormatProperties) \
+        X(vkGetPhysicalDeviceFormatProperties2) \
+        X(vkGetPhysicalDeviceImageFormatProperties) \
+        X(vkEnumerateDeviceExtensionProperties) \
+        X(vkCreateDevice) \
+        X(vkGetDeviceProcAddr) \
+        X(vkDestroySurfaceKHR) \
+        X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+        X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+        X(vkGetPhysicalDeviceSurfaceFormatsKHR) \
+        X(vkGetPhysicalDeviceSurfacePresentModesKHR) \
+        X(vkCreateDebugUtilsMessengerEXT) \
+        X(vkDestroyDebugUtilsMessengerEXT) \
+        X(vkSubmitDebugUtilsMessageEXT)
+
+#define VS_DEVICE_COMMANDS_1_0(X) \
+        X(vkDestroyDevice) \
+        X(vkGetDeviceQueue) \
+        X(vkQueueSubmit) \
+        X(vkQueueWaitIdle) \
+        X(vkDeviceWaitIdle) \
+        X(vkAllocateMemory) \
+        X(vkFreeMemory) \
+        X(vkMapMemory) \
+        X(vkUnmapMemory) \
+        X(vkFlushMappedMemoryRanges) \
+        X(vkInvalidateMappedMemoryRanges) \
+        X(vkGetDeviceMemoryCommitment) \
+        X(vkBindBufferMemory) \
+        X(vkBindImageMemory) \
+        X(vkGetBufferMemoryRequirements) \
+        X(vkGetImageMemoryRequirements) \
+        X(vkGetImageSparseMemoryRequirements) \
+        X(vkQueueBindSparse) \
+        X(vkCreateFence) \
+        X(vkDestroyFence) \
+        X(vkResetFences) \
+        X(vkGetFenceStatus) \
+        X(vkWaitForFences) \
+        X(vkCreateSemaphore) \
+        X(vkDestroySemaphore) \
+        X(vkCreateEvent) \
+        X(vkDestroyEvent) \
+        X(vkGetEventStatus) \
+        X(vkSetEvent) \
+        X(vkResetEvent) \
+        X(vkCreateQueryPool) \
+        X(vkDestroyQueryPool) \
+        X(vkGetQueryPoolResults) \
+        X(vkCreateBuffer) \
+        X(vkDestroyBuffer) \
+        X(vkCreateBufferView) \
+        X(vkDestroyBufferView) \
+        X(vkCreateImage) \
+        X(vkDestroyImage) \
+        X(vkGetImageSubresourceLayout) \
+        X(vkCreateImageView) \
+        X(vkDestroyImageView) \
+        X(vkCreateShaderModule) \
+        X(vkDestroyShaderModule) \
+        X(vkCreatePipelineCache) \
+        X(vkDestroyPipelineCache) \
+        X(vkGetPipelineCacheData) \
+        X(vkMergePipelineCaches) \
+        X(vkCreateGraphicsPipelines) \
+        X(vkCreateComputePipelines) \
+        X(vkDestroyPipeline) \
+        X(vkCreatePipelineLayout) \
+        X(vkDestroyPipelineLayout) \
+        X(vkCreateSampler) \
+        X(vkDestroySampler) \
+        X(vkCreateDescriptorSetLayout) \
+        X(vkDestroyDescriptorSetLayout) \
+        X(vkCreateDescriptorPool) \
+        X(vkDestroyDescriptorPool) \
+        X(vkResetDescriptorPool) \
+        X(vkAllocateDescriptorSets) \
+        X(vkFreeDescriptorSets) \
+        X(vkUpdateDescriptorSets) \
+        X(vkCreateFramebuffer) \
+        X(vkDestroyFramebuffer) \
+        X(vkCreateRenderPass) \
+        X(vkDestroyRenderPass) \
+        X(vkGetRenderAreaGranularity) \
+        X(vkCreateCommandPool) \
+        X(vkDestroyCommandPool) \
+        X(vkResetCommandPool) \
+        X(vkAllocateCommandBuffers) \
+        X(vkFreeCommandBuffers) \
+        X(vkBeginCommandBuffer) \
+        X(vkEndCommandBuffer) \
+        X(vkResetCommandBuffer) \
+        X(vkCmdBindPipeline) \
+        X(vkCmdSetViewport) \
+        X(vkCmdSetScissor) \
+        X(vkCmdSetLineWidth) \
+        X(vkCmdSetDepthBias) \
+        X(vkCmdSetBlendConstants) \
+        X(vkCmdSetDepthBounds) \
+        X(vkCmdSetStencilCompareMask) \
+        X(vkCmdSetStencilWriteMask) \
+        X(vkCmdSetStencilReference) \
+        X(vkCmdBindDescriptorSets) \
+        X(vkCmdBindIndexBuffer) \
+        X(vkCmdBindVertexBuffers) \
+        X(vkCmdDraw) \
+        X(vkCmdDrawIndexed) \
+        X(vkCmdDrawIndirect) \
+        X(vkCmdDrawIndexedIndirect) \
+        X(vkCmdDispatch) \
+        X(vkCmdDispatchIndirect) \
+        X(vkCmdCopyBuffer) \
+        X(vkCmdCopyImage) \
+        X(vkCmdBlitImage) \
+        X(vkCmdCopyBufferToImage) \
+        X(vkCmdCopyImageToBuffer) \
+        X(vkCmdUpdateBuffer) \
+        X(vkCmdFillBuffer) \
+        X(vkCmdClearColorImage) \
+        X(vkCmdClearDepthStencilImage) \
+        X(vkCmdClearAttachments) \
+        X(vkCmdResolveImage) \
+        X(vkCmdSetEvent) \
+        X(vkCmdResetEvent) \
+        X(vkCmdWaitEvents) \
+        X(vkCmdPipelineBarrier) \
+        X(vkCmdBeginQuery) \
+        X(vkCmdEndQuery) \
+        X(vkCmdResetQueryPool) \
+        X(vkCmdWriteTimestamp) \
+        X(vkCmdCopyQueryPoolResults) \
+        X(vkCmdPushConstants) \
+        X(vkCmdBeginRenderPass) \
+        X(vkCmdNextSubpass) \
+        X(vkCmdEndRenderPass) \
+        X(vkCmdExecuteCommands)
+
+#define VS_DEVICE_COMMANDS_1_1(X) \
+        X(vkBindBufferMemory2) \
+        X(vkBindImageMemory2) \
+        X(vkGetDeviceGroupPeerMemoryFeatures) \
+        X(vkCmdSetDeviceMask) \
+        X(vkCmdDispatchBase) \
+        X(vkGetImageMemoryRequirements2) \
+        X(vkGetBufferMemoryRequirements2) \
+        X(vkGetImageSparseMemoryRequirements2) \
+        X(vkTrimCommandPool) \
+        X(vkGetDeviceQueue2) \
+        X(vkCreateSamplerYcbcrConversion) \
+        X(vkDestroySamplerYcbcrConversion) \
+        X(vkCreateDescriptorUpdateTemplate) \
+        X(vkDestroyDescriptorUpdateTemplate) \
+        X(vkUpdateDescriptorSetWithTemplate) \
+        X(vkGetDescriptorSetLayoutSupport)
+
+#define VS_DEVICE_COMMANDS_1_2(X) \
+        X(vkCmdDrawIndirectCount) \
+        X(vkCmdDrawIndexedIndirectCount) \
+        X(vkCreateRenderPass2) \
+        X(vkCmdBeginRenderPass2) \
+        X(vkCmdNextSubpass2) \
+        X(vkCmdEndRenderPass2) \
+        X(vkResetQueryPool) \
+        X(vkGetSemaphoreCounterValue) \
+        X(vkWaitSemaphores) \
+        X(vkSignalSemaphore) \
+        X(vkGetBufferDeviceAddress) \
+        X(vkGetBufferOpaqueCaptureAddress) \
+        X(vkGetDeviceMemoryOpaqueCaptureAddress)
+
+#define VS_DEVICE_COMMANDS_1_3(X) \
+        X(vkCreatePrivateDataSlot) \
+        X(vkDestroyPrivateDataSlot) \
+        X(vkSetPrivateData) \
+        X(vkGetPrivateData) \
+        X(vkCmdSetEvent2) \
+        X(vkCmdResetEvent2) \
+        X(vkCmdWaitEvents2) \
+        X(vkCmdPipelineBarrier2) \
+        X(vkCmdWriteTimestamp2) \
+        X(vkQueueSubmit2) \
+        X(vkCmdCopyBuffer2) \
+        X(vkCmdCopyImage2) \
+        X(vkCmdCopyBufferToImage2) \
+        X(vkCmdCopyImageToBuffer2) \
+        X(vkCmdBlitImage2) \
+        X(vkCmdResolveImage2) \
+        X(vkCmdBeginRendering) \
+        X(vkCmdEndRendering) \
+        X(vkCmdSetCullMode) \
+        X(vkCmdSetFrontFace) \
+        X(vkCmdSetPrimitiveTopology) \
+        X(vkCmdSetViewportWithCount) \
+        X(vkCmdSetScissorWithCount) \
+        X(vkCmdBindVertexBuffers2) \
+        X(vkCmdSetDepthTestEnable) \
+        X(vkCmdSetDepthWriteEnable) \
+        X(vkCmdSetDepthCompareOp) \
+        X(vkCmdSetDepthBoundsTestEnable) \
+        X(vkCmdSetStencilTestEnable) \
+        X(vkCmdSetStencilOp) \
+        X(vkCmdSetRasterizerDiscardEnable) \
+        X(vkCmdSetDepthBiasEnable) \
+        X(vkCmdSetPrimitiveRestartEnable) \
+        X(vkGetDeviceBufferMemoryRequirements) \
+        X(vkGetDeviceImageMemoryRequirements) \
+        X(vkGetDeviceImageSparseMemoryRequirements)
+
+/**
+ * @brief Device level extension commands, only non null in the table when their extension was enabled
+ */
+#define VS_DEVICE_COMMANDS_EXTENSIONS(X) \
+        X(vkCreateSwapchainKHR) \
+        X(vkDestroySwapchainKHR) \
+        X(vkGetSwapchainImagesKHR) \
+        X(vkAcquireNextImageKHR) \
+        X(vkQueuePresentKHR) \
+        X(vkSetDebugUtilsObjectNameEXT) \
+        X(vkSetDebugUtilsObjectTagEXT) \
+        X(vkQueueBeginDebugUtilsLabelEXT) \
+        X(vkQueueEndDebugUtilsLabelEXT) \
+        X(vkQueueInsertDebugUtilsLabelEXT) \
+        X(vkCmdBeginDebugUtilsLabelEXT) \
+        X(vkCmdEndDebugUtilsLabelEXT) \
+        X(vkCmdInsertDebugUtilsLabelEXT) \
+        X(vkGetMemoryHostPointerPropertiesEXT)
+
+#define VS_DISPATCH_MEMBER(command) PFN_ ## command command;
+
+/**
+ * @brief Instance level function pointers, loaded once through `vkGetInstanceProcAddr` when the instance is built
+ * @note A command is NULL if it is not exposed by the instance (e.g. an extension that was not enabled).
+ */
+typedef struct
+{
+    VS_INSTANCE_COMMANDS(VS_DISPATCH_MEMBER)
+} vs_instance_dispatch;
+
+/**
+ * @brief Device level function pointers, loaded through `vkGetDeviceProcAddr` so calls skip the loader trampolines
+ * @note A command is NULL if it is not exposed by the device (e.g. core commands of a newer version than the device
+ *       supports, or commands of an extension that was not enabled).
+ */
+typedef struct
+{
+    VS_DEVICE_COMMANDS_1_0(VS_DISPATCH_MEMBER)
+    VS_DEVICE_COMMANDS_1_1(VS_DISPATCH_MEMBER)
+    VS_DEVICE_COMMANDS_1_2(VS_DISPATCH_MEMBER)
+    VS_DEVICE_COMMANDS_1_3(VS_DISPATCH_MEMBER)
+    VS_DEVICE_COMMANDS_EXTENSIONS(VS_DISPATCH_MEMBER)
+} vs_device_dispatch;
+
+/**
+ * @brief Fills an instance dispatch table
+ *
+ * @param instance The instance to load the commands of
+ * @param get_instance_proc_addr The function used to load the commands
+ * @param[out] out_dispatch Where to write the table
+ */
+void vs_instance_dispatch_load(VkInstance instance, PFN_vkGetInstanceProcAddr get_instance_proc_addr, vs_instance_dispatch *out_dispatch);
+
+/**
+ * @brief Fills a device dispatch table
+ *
+ * @param device The device to load the commands of
+ * @param get_device_proc_addr The function used to load the commands, ideally the one of the driver (see `vs_instance_dispatch`)
+ * @param[out] out_dispatch Where to write the table
+ */
+void vs_device_dispatch_load(VkDevice device, PFN_vkGetDeviceProcAddr get_device_proc_addr, vs_device_dispatch *out_dispatch);
+
+// ### META LOADER
+
+#ifdef VS_LOADER
+
+/*
+ * When built with `VS_LOADER` defined, neither the library nor the application link against `libvulkan` : every command
+ * is a global function pointer of the same name, resolved in three stages.
+ *
+ *  - `vs_loader_init` opens the library and resolves `vkGetInstanceProcAddr` and the global commands.
+ *  - `vs_loader_load_instance` resolves the instance commands, and the device commands as trampolines valid for any
+ *    device. `vs_instance_builder_build` does it on the instance it creates.
+ *  - `vs_loader_load_device` resolves the device commands straight from the driver of a device, for applications
+ *    using a single device (see `vs_device_dispatch` otherwise).
+ */
+
+#define VS_LOADER_DECLARE(command) extern PFN_ ## command command;
+
+VS_LOADER_DECLARE(vkGetInstanceProcAddr)
+VS_GLOBAL_COMMANDS(VS_LOADER_DECLARE)
+VS_INSTANCE_COMMANDS(VS_LOADER_DECLARE)
+VS_DEVICE_COMMANDS_1_0(VS_LOADER_DECLARE)
+VS_DEVICE_COMMANDS_1_1(VS_LOADER_DECLARE)
+VS_DEVICE_COMMANDS_1_2(VS_LOADER_DECLARE)
+VS_DEVICE_COMMANDS_1_3(VS_LOADER_DECLARE)
+VS_DEVICE_COMMANDS_EXTENSIONS(VS_LOADER_DECLARE)
+
+/**
+ * @brief Opens the Vulkan library and resolves the global commands, must be called before any other function
+ *
+ * @param library_path The library to open, either a loader or an ICD, `libvulkan.so.1` (or the platform equivalent) if NULL
+ * @return Wether or not the library could be opened and exposes `vkGetInstanceProcAddr` (or `vk_icdGetInstanceProcAddr`)
+ */
+bool vs_loader_init(const char *library_path);
+
+/**
+ * @brief Resolves the instance commands, and the device commands through the instance
+ */
+void vs_loader_load_instance(VkInstance instance);
+
+/**
+ * @brief Resolves the device commands through `vkGetDeviceProcAddr`, so they skip the trampolines
+ * @note The commands are then only valid for this device.
+ */
+void vs_loader_load_device(VkDevice device);
+
+/**
+ * @brief Closes the library opened by `vs_loader_init`, and clears every command
+ */
+void vs_loader_terminate(void);
+
+#endif
+
+// ### TRACE
+
+#ifdef VS_TRACE
+
+/*
+ * When built with `VS_TRACE` defined, the library records how long each startup phase, each probe of a physical device
+ * and each selection criterion took, along with the number of Vulkan calls made, into the `vs_trace` given to
+ * `vs_instance_builder::trace`. Without it, nothing is recorded and the trace members do not exist.
+ */
+
+#include <stdio.h>
+
+#ifndef VS_TRACE_MAX_EVENTS
+#define VS_TRACE_MAX_EVENTS 1024
+#endif
+
+/**
+ * @brief A span of time spent in the library
+ */
+typedef struct
+{
+    const char   *category;
+    const char   *name;
+
+    /**
+     * @brief The index of the physical device being probed, or -1
+     */
+    int32_t       candidate;
+
+    /**
+     * @brief A small identifier of the thread, counting from 1
+     */
+    uint32_t      thread;
+
+    /**
+     * @brief The number of Vulkan calls made by the thread during the span
+     */
+    uint32_t      vulkan_calls;
+
+    /**
+     * @brief Monotonic time in nanoseconds
+     */
+    uint64_t      start_ns;
+    uint64_t      duration_ns;
+} vs_trace_event;
+
+/**
+ * @brief A fixed size buffer of events, which can be filled from several threads
+ */
+typedef struct vs_trace
+{
+    _Atomic uint32_t    event_count;
+
+    /**
+     * @brief The number of events that did not fit in the buffer
+     */
+    _Atomic uint32_t    dropped_count;
+
+    /**
+     * @brief The number of Vulkan calls made by the library while the trace was attached
+     */
+    _Atomic uint64_t    vulkan_call_count;
+
+    vs_trace_event      events[VS_TRACE_MAX_EVENTS];
+} vs_trace;
+
+/**
+ * @brief Removes all the events of a trace
+ */
+void vs_trace_reset(vs_trace *trace);
+
+/**
+ * @brief Writes a trace in the Chrome trace event format, to open with `chrome://tracing` or Perfetto
+ *
+ * @param trace The trace, no event must be being recorded
+ * @param file Where to write the JSON
+ * @return Wether or not everything could be written
+ */
+bool vs_trace_write_chrome_json(const vs_trace *trace, FILE *file);
+
+#endif
+
 // ### INSTANCE
 
 /**
@@ -57,6 +549,11 @@ typedef struct
      */
     VkInstance    vk_instance;
 
+    /**
+     * @brief The Vulkan version the instance was created with (`VkApplicationInfo::apiVersion`)
+     */
+    uint32_t      api_version;
+
     /**
      * @brief Wether or not a messenger has been created with this instance (i.e. validation layers enabled)
      */
@@ -72,8 +569,62 @@ typedef struct
      * @brief The allocation callbacks to be used on all calls by `cvkstart`
      */
     VkAllocationCallbacks      *allocation_callbacks;
+
+    /**
+     * @brief The instance level commands, loaded once by `vs_instance_builder_build`
+     */
+    vs_instance_dispatch        dispatch;
+
+#ifdef VS_TRACE
+    /**
+     * @brief The trace given to `vs_instance_builder::trace`, recording the calls made with this instance
+     */
+    vs_trace                   *trace;
+#endif
 } vs_instance;
 
+/**
+ * @brief Presets of the validation layer checks, trading coverage for speed
+ * @note Applied with `VK_EXT_layer_settings`, or `VK_EXT_validation_features` with older layers. Settings that a
+ *       profile does not mention keep the values given by the layer configuration (vkconfig, environment ...).
+ */
+typedef enum
+{
+    /**
+     * @brief The layer configuration is left untouched
+     */
+    VS_VALIDATION_PROFILE_DEFAULT = 0,
+
+    /**
+     * @brief Core checks only, without the thread safety and object lifetime checks, to keep validation on under load
+     */
+    VS_VALIDATION_PROFILE_FAST,
+
+    /**
+     * @brief Synchronization validation on top of the default checks
+     */
+    VS_VALIDATION_PROFILE_SYNC,
+
+    /**
+     * @brief GPU-assisted validation (instrumented shaders) on top of the default checks
+     */
+    VS_VALIDATION_PROFILE_GPU_ASSISTED,
+
+    /**
+     * @brief Best practices checks, including performance warnings, on top of the default checks
+     */
+    VS_VALIDATION_PROFILE_BEST_PRACTICES,
+} vs_validation_profile;
+
+/**
+ * @brief Gets a validation profile from its name : "fast", "sync", "gpu-assisted" or "best-practices"
+ *
+ * @param name The name, e.g. from the environment or a configuration file (can be NULL)
+ * @param[out] out_profile Where to write the profile
+ * @return Wether or not the name is known, `out_profile` is not modified if it is not
+ */
+bool vs_validation_profile_from_name(const char *name, vs_validation_profile *out_profile);
+
 
 /**
  * @brief Represents how to build an instance object
@@ -95,6 +646,8 @@ typedef struct
     PFN_vkDebugUtilsMessengerCallbackEXT    messenger_callback; // If NULL default is provided.
     void                                   *messenger_user_data;
     VkDebugUtilsMessageTypeFlagBitsEXT      validation_layers_message_types;
+    VkDebugUtilsMessageSeverityFlagsEXT     validation_layers_message_severities; // If 0, warnings and errors
+    vs_validation_profile                   validation_profile; // Unknown values fail the build
 
     // Layers
     uint32_t                                requested_layer_count;
@@ -106,6 +659,13 @@ typedef struct
 
     // Allocator
     VkAllocationCallbacks                  *allocation_callbacks;
+
+#ifdef VS_TRACE
+    /**
+     * @brief Optional trace in which to record the work of the library, kept in the instance
+     */
+    vs_trace                               *trace;
+#endif
 } vs_instance_builder;
 
 /**
@@ -116,6 +676,26 @@ typedef struct
  */
 bool vs_instance_builder_build(vs_instance_builder instance_builder, vs_instance *instance);
 
+/**
+ * @brief Finds the instance extensions that are not supported, enumerating them once
+ *
+ * @param extension_count The number of extensions to look for
+ * @param extensions The extensions to look for
+ * @param[out] out_missing Where to write the unsupported extensions (can be NULL, can hold `extension_count` elements)
+ * @return The number of unsupported extensions
+ */
+uint32_t vs_instance_missing_extensions(uint32_t extension_count, char **extensions, char **out_missing);
+
+/**
+ * @brief Finds the instance layers that are not supported, enumerating them once
+ *
+ * @param layer_count The number of layers to look for
+ * @param layers The layers to look for
+ * @param[out] out_missing Where to write the unsupported layers (can be NULL, can hold `layer_count` elements)
+ * @return The number of unsupported layers
+ */
+uint32_t vs_instance_missing_layers(uint32_t layer_count, char **layers, char **out_missing);
+
 /**
  * @brief Destroys the instance object given by `vs_instance_builder_build`
  *
@@ -123,6 +703,136 @@ bool vs_instance_builder_build(vs_instance_builder instance_builder, vs_instance
  */
 void vs_instance_destroy(vs_instance    instance);
 
+// ## PHYSICAL DEVICE INFORMATION
+
+#ifndef VS_MAX_QUEUE_FAMILY_COUNT
+#define VS_MAX_QUEUE_FAMILY_COUNT 16
+#endif
+
+#ifndef VS_MAX_DEVICE_EXTENSION_COUNT
+#define VS_MAX_DEVICE_EXTENSION_COUNT 512
+#endif
+
+/**
+ * @brief A snapshot of the capabilities of a physical device, queried once from the driver
+ * @note Every physical device selection criterion and `vs_device_create` read from this structure instead of querying
+ *       the driver again.
+ * @note This structure is large (mostly because of `extensions`), prefer keeping it in static storage or on the heap
+ *       rather than on a small stack. `VS_MAX_DEVICE_EXTENSION_COUNT` can be defined before including this header to
+ *       change its size.
+ */
+typedef struct vs_physical_device_info
+{
+    /**
+     * @brief The physical device this information was queried on
+     */
+    VkPhysicalDevice                    physical_device;
+
+    /**
+     * @brief The properties of the device (`vkGetPhysicalDeviceProperties`)
+     */
+    VkPhysicalDeviceProperties          properties;
+
+    /**
+     * @brief The version of the device usable through the instance, the lower of `properties.apiVersion` and
+     *        `vs_instance::api_version`
+     */
+    uint32_t                            api_version;
+
+    /**
+     * @brief The identifiers of the device (`VkPhysicalDeviceIDProperties`)
+     * @note Only queried if `api_version` is at least Vulkan 1.1, zeroed otherwise. `pNext` is always NULL.
+     */
+    VkPhysicalDeviceIDProperties        id_properties;
+
+    /**
+     * @brief The features supported by the device (`vkGetPhysicalDeviceFeatures`)
+     */
+    VkPhysicalDeviceFeatures            features;
+
+    /**
+     * @brief The Vulkan 1.1, 1.2 and 1.3 features supported by the device
+     * @note Queried along with `features` in a single `vkGetPhysicalDeviceFeatures2` call, zeroed for the versions above
+     *       `api_version`. `pNext` is always NULL.
+     */
+    VkPhysicalDeviceVulkan11Features    features_11;
+    VkPhysicalDeviceVulkan12Features    features_12;
+    VkPhysicalDeviceVulkan13Features    features_13;
+
+    /**
+     * @brief The memory types and heaps of the device (`vkGetPhysicalDeviceMemoryProperties`)
+     */
+    VkPhysicalDeviceMemoryProperties    memory_properties;
+
+    /**
+     * @brief The number of valid elements in `queue_families`
+     */
+    uint32_t                            queue_family_count;
+
+    /**
+     * @brief The queue families of the device (`vkGetPhysicalDeviceQueueFamilyProperties`)
+     */
+    VkQueueFamilyProperties             queue_families[VS_MAX_QUEUE_FAMILY_COUNT];
+
+    /**
+     * @brief The surface with which `present_support` was queried
+     * @note If `VK_NULL_HANDLE`, `present_support` was not queried.
+     */
+    VkSurfaceKHR                        surface;
+
+    /**
+     * @brief For each queue family, wether or not it can present to `surface`
+     */
+    VkBool32                            present_support[VS_MAX_QUEUE_FAMILY_COUNT];
+
+    /**
+     * @brief The number of valid elements in `extensions`
+     */
+    uint32_t                            extension_count;
+
+    /**
+     * @brief The extensions supported by the device (`vkEnumerateDeviceExtensionProperties`)
+     * @note If the device supports more than `VS_MAX_DEVICE_EXTENSION_COUNT` extensions, the list is truncated.
+     */
+    VkExtensionProperties               extensions[VS_MAX_DEVICE_EXTENSION_COUNT];
+
+    /**
+     * @brief Slots of the name set of `extensions`, see `vs_physical_device_info_extension_set`
+     */
+    uint16_t                            extension_slots[VS_NAME_SET_SLOT_COUNT(VS_MAX_DEVICE_EXTENSION_COUNT)];
+} vs_physical_device_info;
+
+/**
+ * @brief Queries all the information `cvkstart` needs about a physical device, calling each driver entry point once
+ *
+ * @param physical_device The physical device to query
+ * @param surface The surface with which to query present support, can be `VK_NULL_HANDLE` to skip this query
+ * @param instance The instance the device was enumerated from, whose version limits the queries
+ * @param[out] info A pointer to where to write the information
+ */
+void vs_physical_device_info_query(VkPhysicalDevice physical_device, VkSurfaceKHR surface, vs_instance instance, vs_physical_device_info *info);
+
+/**
+ * @brief Gets the set of extensions supported by a device, built when the information was queried
+ *
+ * @param info The information of the device
+ * @return The set, only valid as long as `info` is
+ */
+vs_name_set vs_physical_device_info_extension_set(const vs_physical_device_info *info);
+
+/**
+ * @brief Finds the device extensions that are not supported, e.g. to disable optional ones
+ *
+ * @param info The information of the device
+ * @param extension_count The number of extensions to look for
+ * @param extensions The extensions to look for
+ * @param[out] out_missing Where to write the unsupported extensions (can be NULL, can hold `extension_count` elements)
+ * @return The number of unsupported extensions
+ */
+uint32_t    vs_physical_device_info_missing_extensions(const vs_physical_device_info *info, uint32_t extension_count, char **extensions, char **out_missing);
+
+typedef struct vs_queue vs_queue;
+
 /**
  * @brief Represents a VkQueue request that must be fullfilled when creating a device
  */
@@ -139,15 +849,75 @@ typedef struct
      */
     VkQueue   *destination;
 
+    /**
+     * @brief Optional, where to initialize a `vs_queue` wrapping the created queue
+     * @note Unused when used for querying physical device
+     * @note The wrappers of requests sharing a queue forward to the same one, see `vs_queue_init_shared`
+     * @note Wrappers submit with `vkQueueSubmit2`, which needs the `synchronization2` feature. It is enabled along the
+     *       wrappers in Vulkan 1.3, or when `VK_KHR_synchronization2` is in `vs_device_builder::enable_extensions`
+     *       (unless a `VkPhysicalDeviceSynchronization2FeaturesKHR` is chained by the user). The device is not created
+     *       otherwise
+     */
+    vs_queue  *wrapper;
+
     /**
      * @brief A pointer to a floating point used for creating queues
      * @note Unused/Can be null when used for querying physical device
-     * @note If null when creating device a static float of value `1.0` will be used
+     * @note If null when creating device a priority of `1.0` will be used
+     * @note If several requests share a queue, the highest of their priorities is used
      */
     float   *queue_priority;
 
+    /**
+     * @brief Optional system wide priority of the queue (`VK_KHR_global_priority`), ignored if zero or if neither
+     *        `VK_KHR_global_priority` nor `VK_EXT_global_priority` is in `vs_device_builder::enable_extensions`
+     * @note Unused when used for querying physical device
+     * @note Applies to the whole queue family, the highest one requested in the family is used. If the driver refuses
+     *       it (`VK_ERROR_NOT_PERMITTED_KHR`), the device is created again with lower priorities, down to the default.
+     */
+    VkQueueGlobalPriorityKHR    global_priority;
+
 } vs_queue_request;
 
+/**
+ * @brief The type of a member of `VkPhysicalDeviceLimits`
+ */
+typedef enum
+{
+    VS_LIMIT_TYPE_UINT32,
+    VS_LIMIT_TYPE_INT32,
+    VS_LIMIT_TYPE_FLOAT,
+    VS_LIMIT_TYPE_UINT64,
+} vs_limit_type;
+
+/**
+ * @brief A device limit that contributes `weight * value` to the score of the devices
+ * @note Use `VS_LIMIT_WEIGHT` to fill it
+ */
+typedef struct
+{
+    /**
+     * @brief The offset of the limit in `VkPhysicalDeviceLimits`
+     */
+    size_t           offset;
+    vs_limit_type    type;
+    float            weight;
+} vs_limit_weight;
+
+/**
+ * @brief Initializer of a `vs_limit_weight`, e.g. `VS_LIMIT_WEIGHT(maxComputeWorkGroupInvocations, 0.1f)`
+ */
+#define VS_LIMIT_WEIGHT(limit, w)                                   \
+    {                                                               \
+        .offset = offsetof(VkPhysicalDeviceLimits, limit),          \
+        .type   = _Generic( ( (VkPhysicalDeviceLimits *)0 )->limit, \
+                            int32_t: VS_LIMIT_TYPE_INT32,           \
+                            float: VS_LIMIT_TYPE_FLOAT,             \
+                            uint64_t: VS_LIMIT_TYPE_UINT64,         \
+                            default: VS_LIMIT_TYPE_UINT32),         \
+        .weight = (w),                                              \
+    }
+
 /**
  * @brief Represents the criteria that a physical device must follow in order to be selected
  * @note Must be zero initalized so that fields that aren't used are detected as such
@@ -181,6 +951,12 @@ typedef struct
      */
     vs_queue_request           *required_queues;
 
+    /**
+     * @brief Wether or not requests may share queues when the device does not have enough of them
+     * @note Should match `vs_device_builder::allow_shared_queues`
+     */
+    bool                        allow_shared_queues;
+
     /**
      * @brief The number of required extensions
      */
@@ -191,99 +967,1918 @@ typedef struct
      */
     char                      **required_extensions;
 
+    /**
+     * @brief Optional extensions that raise the score of the devices supporting them, see
+     *        `vs_device_builder::optional_extensions`
+     */
+    uint32_t                    preferred_extension_count;
+    char                      **preferred_extensions;
+
     /**
      * @brief The required feature set that the device must support
      */
     VkPhysicalDeviceFeatures    required_features;
 
     /**
-     * @brief The device type to strictly require
+     * @brief The required Vulkan 1.1, 1.2 and 1.3 features that the device must support
+     * @note Only the feature booleans are read, `sType` and `pNext` are ignored.
+     */
+    VkPhysicalDeviceVulkan11Features    required_features_11;
+    VkPhysicalDeviceVulkan12Features    required_features_12;
+    VkPhysicalDeviceVulkan13Features    required_features_13;
+
+    /**
+     * @brief The device type to strictly require
      */
     VkPhysicalDeviceType        required_types;
 
     /**
-     * @brief In the event of multiple device being available
-     *        through previous criterion, which type to prefer
+     * @brief In the event of multiple device being available
+     *        through previous criterion, which type to prefer
+     * @note Ignored if zero, see `vs_physical_device_info_score`
+     */
+    VkPhysicalDeviceType    preferred_type;
+
+    /**
+     * @brief The number of weighted limits
+     */
+    uint32_t                limit_weight_count;
+
+    /**
+     * @brief Optional array of device limits that contribute to the score of the devices
+     */
+    const vs_limit_weight  *limit_weights;
+
+    /**
+     * @brief Optional path to a file in which to cache the selection result between runs
+     * @note If NULL, no cache is used. On a hit, the criterions are skipped and devices are only identified using
+     *       their `deviceUUID`, `driverVersion` and `pipelineCacheUUID`, so a driver update invalidates the cache.
+     * @note Requires devices supporting Vulkan 1.1, and a POSIX platform.
+     */
+    const char             *cache_path;
+
+} vs_physical_device_selector;
+
+
+/**
+ * @brief A suitable device along with its score
+ */
+typedef struct
+{
+    VkPhysicalDevice    physical_device;
+    float               score;
+} vs_suitable_device;
+
+/**
+ * @brief Scores a device, the higher the better, only used to rank the devices that are suitable for a selector
+ *
+ * The score is the sum of :
+ * - 1000 if the device is of `selector.preferred_type`
+ * - 300 for a discrete GPU, 200 for an integrated GPU, 100 for a virtual GPU and 50 for a CPU
+ * - 10 per GiB of the largest device local heap
+ * - 50 if the device has a compute queue family without graphics, and 50 if it has a transfer queue family without
+ *   graphics nor compute
+ * - `weight * value` for each of `selector.limit_weights`
+ * - 100 per supported extension of `selector.preferred_extensions`
+ *
+ * @param info The information of the device
+ * @param selector The selector
+ * @return The score of the device
+ */
+float vs_physical_device_info_score(const vs_physical_device_info *info, vs_physical_device_selector selector);
+
+/**
+ * @brief Lists the suitable devices, ranked by decreasing score
+ *
+ * @param selector The selector, its `cache_path` is ignored
+ * @param instance The instance on which to enumerate devices
+ * @param[in,out] count The capacity of `out_devices`, set to the number of written devices (or of suitable devices if
+ *                      `out_devices` is NULL)
+ * @param[out] out_devices Where to write the ranked devices (can be NULL)
+ * @note No device is listed if the snapshot of the devices cannot be allocated
+ */
+void vs_enumerate_suitable_devices(vs_physical_device_selector selector, vs_instance instance, uint32_t *count, vs_suitable_device *out_devices);
+
+/**
+ * @brief Selects the suitable physical device with the highest score, based on the specified selecion criteria
+ *
+ * @param selector The selector
+ * @return A suitable physical device or `VK_NULL_HANDLE` if no suitable device was found.
+ */
+VkPhysicalDevice vs_select_physical_device(vs_physical_device_selector selector, vs_instance instance);
+
+/**
+ * @brief Selects the suitable physical device with the highest score, based on the specified selecion criteria, and
+ *        keeps the information queried on it
+ *
+ * @param selector The selector
+ * @param instance The instance on which to enumerate devices
+ * @param[out] info Where to write the information of the selected device, can then be given to `vs_device_builder`
+ * @return Wether or not a suitable device was found
+ * @note The content of `info` is undefined if the return value is false
+ */
+bool vs_select_physical_device_info(vs_physical_device_selector selector, vs_instance instance, vs_physical_device_info *info);
+
+// ## MEMORY POLICY
+
+/*
+ * A `vs_memory_policy` ranks, once per device, the memory types suited to each way memory is used, so that allocating
+ * is picking the first ranked type allowed by `VkMemoryRequirements::memoryTypeBits`.
+ *
+ * Host visible device local memory is the fastest way to upload on resizable BAR (when the whole device heap is host
+ * visible) and on UMA devices (where every heap is device local), it is only preferred there : the 256 MiB BAR of other
+ * discrete devices is left to explicit requests.
+ */
+
+/**
+ * @brief The ways memory is used, each has its own ranking of memory types
+ */
+typedef enum
+{
+    /**
+     * @brief Only accessed by the device, e.g. textures and render targets
+     */
+    VS_MEMORY_USAGE_GPU_ONLY,
+
+    /**
+     * @brief Written by the host, often and sequentially, and read by the device, e.g. uniform and dynamic vertex buffers
+     */
+    VS_MEMORY_USAGE_UPLOAD,
+
+    /**
+     * @brief Written by the device and read by the host, prefers cached memory
+     */
+    VS_MEMORY_USAGE_READBACK,
+
+    /**
+     * @brief Written once by the host as the source of a transfer, kept out of device local memory
+     */
+    VS_MEMORY_USAGE_STAGING,
+
+    /**
+     * @brief Attachments living within a render pass, prefers lazily allocated memory
+     */
+    VS_MEMORY_USAGE_TRANSIENT,
+
+    VS_MEMORY_USAGE_COUNT,
+} vs_memory_usage;
+
+typedef struct
+{
+    VkPhysicalDevice                    physical_device;
+    VkPhysicalDeviceMemoryProperties    memory_properties;
+
+    /**
+     * @brief Wether or not all the device local memory is host visible (resizable BAR) on a discrete device
+     */
+    bool                                rebar;
+
+    /**
+     * @brief Wether or not every heap is device local, as on integrated devices
+     */
+    bool                                uma;
+
+    /**
+     * @brief Wether or not the budgets are queried with `VK_EXT_memory_budget`
+     */
+    bool                                memory_budget;
+
+    /**
+     * @brief The memory the process can use and uses on each heap, see `vs_memory_policy_update_budget`
+     * @note Without `VK_EXT_memory_budget`, the budget is the size of the heap and the usage is zero
+     */
+    VkDeviceSize                        heap_budgets[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize                        heap_usages[VK_MAX_MEMORY_HEAPS];
+
+    /**
+     * @brief For each usage, the suitable memory types, most suited first
+     */
+    uint32_t                            type_counts[VS_MEMORY_USAGE_COUNT];
+    uint8_t                             types[VS_MEMORY_USAGE_COUNT][VK_MAX_MEMORY_TYPES];
+} vs_memory_policy;
+
+/**
+ * @brief Ranks the memory types of a physical device for each usage
+ *
+ * @param physical_device The physical device
+ * @param memory_properties The memory properties of the device (e.g. from `vs_physical_device_info`), queried if NULL
+ * @param memory_budget Wether or not `VK_EXT_memory_budget` is enabled on the device
+ * @param[out] out_policy Where to write the policy
+ */
+void vs_memory_policy_build(VkPhysicalDevice physical_device, const VkPhysicalDeviceMemoryProperties *memory_properties, bool memory_budget, vs_memory_policy *out_policy);
+
+/**
+ * @brief Queries the budgets of each heap again, does nothing without `VK_EXT_memory_budget`
+ * @note The budgets change with the allocations of every process, this is meant to be called once a frame or so.
+ */
+void vs_memory_policy_update_budget(vs_memory_policy *policy);
+
+/**
+ * @brief Finds the most suited memory type for an allocation
+ *
+ * @param policy The policy of the device
+ * @param usage The way the memory is used
+ * @param memory_type_bits The memory types allowed for the resource (`VkMemoryRequirements::memoryTypeBits`)
+ * @param size The size of the allocation, types whose heap has less than that left in its budget are skipped (0 to
+ *        ignore budgets)
+ * @param[out] out_type_index Where to write the memory type index
+ * @return Wether or not a memory type was found
+ * @note The integer pointed to by `out_type_index` will not be modified if the return value is false
+ */
+bool vs_memory_policy_find_type(const vs_memory_policy *policy, vs_memory_usage usage, uint32_t memory_type_bits, VkDeviceSize size, uint32_t *out_type_index);
+
+// ## MEMORY ARENA
+
+/*
+ * A `vs_memory_arena` sub-allocates device memory from large blocks, so that resources do not each cost a
+ * `vkAllocateMemory` call (a kernel round trip, limited to `maxMemoryAllocationCount` allocations, often 4096).
+ *
+ * Blocks are split with a TLSF (two level segregated fit) allocator : finding and freeing a range takes constant time,
+ * whatever the number of live allocations. Memory types are picked with the `vs_memory_policy` of the arena, and
+ * host visible blocks stay mapped.
+ *
+ * When `bufferImageGranularity` is above 1, linear resources (buffers and linear images) and optimal images are
+ * allocated from separate blocks so that they never share a page. Large resources, and the ones the driver prefers to
+ * have on their own, get a dedicated allocation.
+ *
+ * For memory rewritten every frame, a `vs_memory_linear` hands out ranges of a single arena allocation by bumping an
+ * offset, either reset at once (linear) or released in order (ring).
+ *
+ * Arenas are not thread safe.
+ */
+
+#ifndef VS_MEMORY_ARENA_BLOCK_SIZE
+#define VS_MEMORY_ARENA_BLOCK_SIZE (64ull << 20)
+#endif
+
+typedef struct
+{
+    /**
+     * @brief The size of the blocks, `VS_MEMORY_ARENA_BLOCK_SIZE` if zero (an eighth of heaps smaller than 1 GiB)
+     */
+    VkDeviceSize    block_size;
+
+    /**
+     * @brief The `bufferImageGranularity` limit of the device
+     */
+    VkDeviceSize    buffer_image_granularity;
+
+    /**
+     * @brief The size from which allocations are dedicated, half the block size if zero
+     */
+    VkDeviceSize    dedicated_threshold;
+
+    /**
+     * @brief Wether or not `VK_KHR_dedicated_allocation` (core in Vulkan 1.1) is available, to chain
+     *        `VkMemoryDedicatedAllocateInfo` and honour `vs_memory_request::prefers_dedicated`
+     */
+    bool            dedicated_allocation;
+
+    /**
+     * @brief The `minImportedHostPointerAlignment` of the device, and the command querying the memory types of a host
+     *        pointer, zero and NULL unless `VK_EXT_external_memory_host` is enabled, see `vs_file_buffer_open`
+     */
+    VkDeviceSize                            min_imported_host_pointer_alignment;
+    PFN_vkGetMemoryHostPointerPropertiesEXT get_memory_host_pointer_properties;
+} vs_memory_arena_info;
+
+/**
+ * @brief Represents a request for memory
+ */
+typedef struct
+{
+    /**
+     * @brief The requirements of the resource (`vkGetBufferMemoryRequirements` or `vkGetImageMemoryRequirements`)
+     */
+    VkMemoryRequirements    requirements;
+    vs_memory_usage         usage;
+
+    /**
+     * @brief Wether or not the resource is an image with optimal tiling, see `bufferImageGranularity`
+     */
+    bool                    optimal_image;
+
+    /**
+     * @brief Wether or not the driver prefers or requires a dedicated allocation (`VkMemoryDedicatedRequirements`)
+     */
+    bool                    prefers_dedicated;
+
+    /**
+     * @brief The resource, given to `VkMemoryDedicatedAllocateInfo` if the allocation is dedicated (can be
+     *        `VK_NULL_HANDLE`)
+     */
+    VkImage                 dedicated_image;
+    VkBuffer                dedicated_buffer;
+
+    /**
+     * @brief Wether or not a `vs_memory_defrag` may move the allocation, ignored for optimal images
+     */
+    bool                    movable;
+
+    /**
+     * @brief Given back with the relocations of the allocation, see `vs_memory_relocation`
+     */
+    void                   *user_data;
+} vs_memory_request;
+
+typedef struct _vs_memory_block _vs_memory_block;
+typedef struct vs_memory_defrag vs_memory_defrag;
+
+/**
+ * @brief A range of device memory
+ */
+typedef struct
+{
+    VkDeviceMemory       memory;
+    VkDeviceSize         offset;
+    VkDeviceSize         size;
+    uint32_t             type_index;
+
+    /**
+     * @brief The host address of the range, NULL if the memory is not host visible
+     */
+    void                *mapped;
+
+    /**
+     * @brief Wether or not the range has its own `VkDeviceMemory`
+     */
+    bool                 dedicated;
+
+    // Where the range comes from, NULL for dedicated allocations and the ranges of a `vs_memory_linear`
+    _vs_memory_block    *block;
+    uint32_t             node;
+} vs_memory_allocation;
+
+/**
+ * @brief The state of an arena, see `vs_memory_arena_stats_get`
+ */
+typedef struct
+{
+    /**
+     * @brief The live `VkDeviceMemory` objects, blocks and dedicated allocations
+     */
+    uint32_t        block_count;
+    uint32_t        dedicated_count;
+
+    /**
+     * @brief The live allocations, dedicated ones included
+     */
+    uint32_t        allocation_count;
+
+    VkDeviceSize    block_bytes;
+    VkDeviceSize    dedicated_bytes;
+
+    /**
+     * @brief The bytes of the blocks given to allocations, alignment padding included
+     */
+    VkDeviceSize    used_bytes;
+
+    /**
+     * @brief The free ranges of the blocks, fragmentation shows as many ranges with a small largest one
+     */
+    uint32_t        free_range_count;
+    VkDeviceSize    largest_free_range;
+
+    /**
+     * @brief The allocations and frees since the arena was initialized
+     */
+    uint64_t        total_allocations;
+    uint64_t        total_frees;
+} vs_memory_arena_stats;
+
+typedef struct
+{
+    VkDevice                        device;
+    const VkAllocationCallbacks    *allocation_callbacks;
+    vs_memory_arena_info            info;
+
+    /**
+     * @brief The policy picking the memory types, its budgets can be updated with `vs_memory_policy_update_budget`
+     * @note The heap usages are increased by the blocks the arena allocates, until the next budget update.
+     */
+    vs_memory_policy                policy;
+
+    /**
+     * @brief The blocks of each memory type, linear resources first and optimal images second
+     */
+    _vs_memory_block               *blocks[VK_MAX_MEMORY_TYPES][2];
+
+    vs_memory_arena_stats           stats;
+
+    /**
+     * @brief The defragmenter of the arena, if any
+     */
+    vs_memory_defrag               *defrag;
+} vs_memory_arena;
+
+/**
+ * @brief Initializes an empty arena, no memory is allocated until the first request
+ *
+ * @param[out] arena The arena
+ * @param device The device on which to allocate
+ * @param policy The memory policy of the device, copied
+ * @param allocation_callbacks The callbacks used for the bookkeeping of the arena and given to Vulkan (can be NULL)
+ * @param info The configuration of the arena
+ */
+void vs_memory_arena_init(vs_memory_arena *arena, VkDevice device, const vs_memory_policy *policy, const VkAllocationCallbacks *allocation_callbacks, vs_memory_arena_info info);
+
+/**
+ * @brief Frees every block of the arena, every allocation must have been freed
+ */
+void vs_memory_arena_destroy(vs_memory_arena *arena);
+
+/**
+ * @brief Allocates memory
+ *
+ * @param arena The arena
+ * @param request The request
+ * @param[out] out_allocation Where to write the allocation
+ * @return Wether or not the request could be fulfilled
+ */
+bool vs_memory_arena_allocate(vs_memory_arena *arena, const vs_memory_request *request, vs_memory_allocation *out_allocation);
+
+/**
+ * @brief Frees an allocation of the arena, and zeroes it
+ * @note The ranges of a `vs_memory_linear` are ignored.
+ * @note An allocation being moved by a `vs_memory_defrag` is only released once its copy completed, and its
+ *       relocation is not published.
+ */
+void vs_memory_arena_free(vs_memory_arena *arena, vs_memory_allocation *allocation);
+
+/**
+ * @brief Gets the state of an arena
+ */
+void vs_memory_arena_stats_get(const vs_memory_arena *arena, vs_memory_arena_stats *out_stats);
+
+typedef struct
+{
+    /**
+     * @brief The arena allocation the ranges are taken from
+     */
+    vs_memory_allocation    allocation;
+    bool                    ring;
+
+    /**
+     * @brief The bytes handed out and released since the last reset, the live ranges are between the two
+     */
+    uint64_t                head;
+    uint64_t                tail;
+} vs_memory_linear;
+
+/**
+ * @brief Allocates the memory of a linear or ring allocator from an arena
+ *
+ * @param arena The arena
+ * @param usage The way the memory is used
+ * @param size The size of the memory shared by the ranges
+ * @param ring Wether or not ranges are released in order with `vs_memory_linear_release`, otherwise all at once with
+ *        `vs_memory_linear_reset`
+ * @param[out] out_linear Where to write the allocator
+ * @return Wether or not the memory could be allocated
+ */
+bool     vs_memory_linear_init(vs_memory_arena *arena, vs_memory_usage usage, VkDeviceSize size, bool ring, vs_memory_linear *out_linear);
+
+/**
+ * @brief Gives the memory of the allocator back to the arena
+ */
+void     vs_memory_linear_destroy(vs_memory_arena *arena, vs_memory_linear *linear);
+
+/**
+ * @brief Hands out a range
+ *
+ * @param linear The allocator
+ * @param size The size of the range
+ * @param alignment The alignment of the range offset in the `VkDeviceMemory`
+ * @param[out] out_allocation Where to write the range
+ * @return Wether or not there was enough room
+ * @note A ring never wraps a range around its end, the end is skipped instead
+ */
+bool     vs_memory_linear_allocate(vs_memory_linear *linear, VkDeviceSize size, VkDeviceSize alignment, vs_memory_allocation *out_allocation);
+
+/**
+ * @brief Gets the position after the last range handed out, e.g. at the end of a frame, to be released later
+ */
+uint64_t vs_memory_linear_mark(const vs_memory_linear *linear);
+
+/**
+ * @brief Releases the ranges handed out before `mark`, e.g. once the frame that used them completed
+ */
+void     vs_memory_linear_release(vs_memory_linear *linear, uint64_t mark);
+
+/**
+ * @brief Releases every range
+ */
+void     vs_memory_linear_reset(vs_memory_linear *linear);
+
+// ## MEMORY DEFRAGMENTATION
+
+/*
+ * A `vs_memory_defrag` compacts an arena a little at a time : each step moves the movable allocations of the sparsest
+ * block to the other blocks of its memory type with GPU copies, until the block is empty and given back.
+ *
+ * Only allocations requested with `vs_memory_request::movable` are moved, and only buffers can be (optimal images are
+ * never). Their content must not be written by the GPU while the defragmenter runs, as the copy could miss it. Once
+ * the copies of a step completed, the relocation callback gives the new range of each moved allocation, to which the
+ * application binds a new buffer. The old range is kept for `vs_memory_defrag_info::release_delay` more steps, for
+ * the frames still reading it. Until then, the application can still free the old allocation instead of the new one,
+ * and both ranges are then given back.
+ *
+ * Steps never wait for the GPU, and copy at most `vs_memory_defrag_info::max_bytes_per_step` bytes, so that they can
+ * be run once per frame.
+ */
+
+#ifndef VS_MEMORY_DEFRAG_MAX_MOVES
+#define VS_MEMORY_DEFRAG_MAX_MOVES 64
+#endif
+
+#ifndef VS_MEMORY_DEFRAG_STEP_BYTES
+#define VS_MEMORY_DEFRAG_STEP_BYTES (8ull << 20)
+#endif
+
+/**
+ * @brief Describes a moved allocation
+ */
+typedef struct
+{
+    /**
+     * @brief The `vs_memory_request::user_data` of the allocation
+     */
+    void                   *user_data;
+
+    /**
+     * @brief The new allocation, to replace the old one with, its size may be larger than the requested one
+     */
+    vs_memory_allocation    allocation;
+
+    /**
+     * @brief The range the allocation was moved from
+     */
+    VkDeviceMemory          old_memory;
+    VkDeviceSize            old_offset;
+} vs_memory_relocation;
+
+/**
+ * @brief Called once the content of an allocation was copied to its new range
+ */
+typedef void (*vs_memory_relocation_callback)(const vs_memory_relocation *relocation, void *user_data);
+
+typedef struct
+{
+    /**
+     * @brief The bytes copied by a step at most, `VS_MEMORY_DEFRAG_STEP_BYTES` if zero
+     * @note A single allocation larger than that is still moved, alone.
+     */
+    VkDeviceSize                     max_bytes_per_step;
+
+    /**
+     * @brief Blocks whose used part is above this fraction are left alone, 0.5 if zero
+     */
+    float                            max_block_usage;
+
+    /**
+     * @brief The number of steps the old ranges of a pass are kept after its relocations are published, e.g. the
+     *        number of frames in flight
+     */
+    uint32_t                         release_delay;
+
+    vs_memory_relocation_callback    relocation_callback;
+    void                            *user_data;
+
+    /**
+     * @brief Optional, the wrapper of the queue to submit the copies through, when other threads (or an upload ring)
+     *        submit to it
+     * @note `vs_memory_defrag_destroy` waits for the wrapper to drain the last copies, from another thread.
+     * @note The copies are then submitted with `vkQueueSubmit2`, the device needs `synchronization2` like for
+     *       `vs_queue_request::wrapper`
+     */
+    vs_queue                        *wrapper;
+} vs_memory_defrag_info;
+
+/**
+ * @brief Counters of a defragmenter, since it was initialized
+ */
+typedef struct
+{
+    uint64_t        steps;
+
+    /**
+     * @brief The steps that recorded copies
+     */
+    uint64_t        passes;
+    uint64_t        allocations_moved;
+    VkDeviceSize    bytes_moved;
+    uint64_t        blocks_freed;
+
+    /**
+     * @brief The moves abandoned because the allocation was freed meanwhile
+     */
+    uint64_t        cancelled_moves;
+} vs_memory_defrag_stats;
+
+typedef struct
+{
+    uint32_t    source_node;
+    uint32_t    destination_node;
+    bool        cancelled;
+} _vs_memory_move;
+
+struct vs_memory_defrag
+{
+    vs_memory_arena            *arena;
+    vs_memory_defrag_info       info;
+
+    VkQueue                     queue;
+    VkCommandPool               command_pool;
+    VkCommandBuffer             command_buffer;
+    VkFence                     fence;
+
+    // Kept in the defragmenter, as a `vs_queue` reads them once drained
+    VkCommandBufferSubmitInfo   command_buffer_info;
+    VkSubmitInfo2               submit_info;
+    uint64_t                    ticket;
+
+    // The moves of the pass in flight, all from `source` to `destination`
+    _vs_memory_block           *source;
+    _vs_memory_block           *destination;
+    uint32_t                    move_count;
+    _vs_memory_move             moves[VS_MEMORY_DEFRAG_MAX_MOVES];
+    bool                        submitted;
+    bool                        published;
+    uint32_t                    release_countdown;
+
+    vs_memory_defrag_stats      stats;
+};
+
+/**
+ * @brief Initializes a defragmenter, the arena can only have one
+ *
+ * @param[out] defrag The defragmenter
+ * @param arena The arena to defragment
+ * @param queue The queue the copies are submitted to, e.g. a transfer queue requested to `vs_device_create`
+ * @param queue_family_index The family of `queue`, see `vs_device_builder::out_assignments`
+ * @param info The configuration of the defragmenter
+ * @return Wether or not the command pool and the fence could be created
+ */
+bool vs_memory_defrag_init(vs_memory_defrag *defrag, vs_memory_arena *arena, VkQueue queue, uint32_t queue_family_index, vs_memory_defrag_info info);
+
+/**
+ * @brief Waits for the copies in flight, publishes their relocations and releases everything, including the old ranges
+ *        whatever the release delay
+ */
+void vs_memory_defrag_destroy(vs_memory_defrag *defrag);
+
+/**
+ * @brief Advances the defragmentation, without waiting for the GPU
+ *
+ * Publishes the relocations of the previous pass once its copies completed, releases the old ranges once the release
+ * delay elapsed, and then records and submits the copies of the next pass.
+ *
+ * @param defrag The defragmenter
+ * @return Wether or not there is anything left to do, the arena is compact when it is `false`
+ */
+bool vs_memory_defrag_step(vs_memory_defrag *defrag);
+
+// ## DEVICE CREATION
+
+/**
+ * @brief Value of `vs_queue_assignment::shares_with` for a queue used by a single request
+ */
+#define VS_QUEUE_NOT_SHARED UINT32_MAX
+
+/**
+ * @brief Describes the queue given to a request by `vs_device_create`
+ */
+typedef struct
+{
+    uint32_t                    family_index;
+    uint32_t                    queue_index;
+
+    /**
+     * @brief The flags of the whole queue family, which may be more than the requested ones
+     */
+    VkQueueFlags                family_flags;
+    uint32_t                    timestamp_valid_bits;
+
+    /**
+     * @brief The global priority granted to the family, zero if none was requested or granted
+     */
+    VkQueueGlobalPriorityKHR    global_priority;
+
+    /**
+     * @brief The lowest index of another request given the same `VkQueue`, or `VS_QUEUE_NOT_SHARED`
+     * @note Submissions to a shared queue must be externally synchronized, see `vs_device_builder::allow_shared_queues`
+     */
+    uint32_t                    shares_with;
+} vs_queue_assignment;
+
+typedef struct
+{
+    /**
+     * @brief The number of queues to request
+     */
+    uint32_t            queue_request_count;
+
+    /**
+     * @brief A pointer to a list of queue requests struct, with valid pointers in the `vs_queue_request::destination` field.
+     */
+    vs_queue_request   *queue_requests;
+
+    /**
+     * @brief Wether or not requests may share queues when the device does not have enough of them
+     * @note Shared queues are written as the same `VkQueue` to several destinations, submissions to them must then be
+     *       externally synchronized by the application.
+     */
+    bool                allow_shared_queues;
+
+    /**
+     * @brief Wether or not to request a present queue
+     */
+    bool                request_present_queue;
+
+    /**
+     * @brief The surface with which to query for the present queue. Cannot be `VK_NULL_HANDLE` unless `request_present_queue` is `false`
+     */
+    VkSurfaceKHR        surface;
+
+    /**
+     * @brief Where to write the gotten present queue. Cannot be `VK_NULL_HANDLE` unless `request_present_queue` is `false`
+     * @note The present queue can be selected amongst the previously acquired queue, but this is not necessary.
+     */
+    VkQueue                    *present_destination;
+
+    /**
+     * @brief Optional, where to initialize a `vs_queue` wrapping the present queue
+     * @note Like `vs_queue_request::wrapper`, the device is not created without the `synchronization2` feature
+     */
+    vs_queue                   *present_wrapper;
+
+    /**
+     * @brief Optional array of `queue_request_count` elements, in which to describe the queue given to each request
+     */
+    vs_queue_assignment        *out_assignments;
+
+    /**
+     * @brief Optional, where to describe the present queue, only written if `request_present_queue` is `true`
+     * @note `vs_queue_assignment::shares_with` is the request whose queue is used for presentation, if any
+     */
+    vs_queue_assignment        *out_present_assignment;
+
+    /**
+     * @brief The features to enable on the device.
+     */
+    VkPhysicalDeviceFeatures    features;
+
+    /**
+     * @brief The Vulkan 1.1, 1.2 and 1.3 features to enable on the device
+     * @note Only the feature booleans are read, `sType` and `pNext` are set by `vs_device_create`. A structure with no
+     *       feature enabled is not chained, so that devices not supporting its version can still be created.
+     */
+    VkPhysicalDeviceVulkan11Features    features_11;
+    VkPhysicalDeviceVulkan12Features    features_12;
+    VkPhysicalDeviceVulkan13Features    features_13;
+
+    /**
+     * @brief Optional `pNext` chain of additional feature structures (e.g. extension features) to enable
+     * @note If not NULL, features are given to the device through `VkPhysicalDeviceFeatures2`.
+     */
+    void                       *features_next;
+
+    /**
+     * @brief The amount of extensions to enable
+     */
+    uint32_t                    enable_extension_count;
+
+    /**
+     * @brief A pointer to a list of string literals of extensions to enable on the device.
+     */
+    char                      **enable_extensions;
+
+    /**
+     * @brief Extensions enabled only if the device supports them (e.g. `VK_EXT_external_memory_host`)
+     * @note They are looked up in `physical_device_info` if it holds the extensions, enumerated otherwise. Enabled
+     *       optional extensions count as `enable_extensions` everywhere else.
+     */
+    uint32_t                    optional_extension_count;
+    char                      **optional_extensions;
+
+    /**
+     * @brief Optional array of `optional_extension_count` elements, in which to write wether each optional extension
+     *        was enabled
+     */
+    bool                       *out_optional_enabled;
+
+    /**
+     * @brief Optional information previously queried on the physical device (e.g. by `vs_select_physical_device_info`)
+     * @note If NULL, the queue families are queried again from the driver.
+     */
+    const vs_physical_device_info *physical_device_info;
+
+    /**
+     * @brief Optional path to a file in which to cache the queue family assignment between runs
+     * @note Can be the same file as `vs_physical_device_selector::cache_path`.
+     * @note Present support is not checked again on a hit, the surface is assumed to be compatible with the one of
+     *       the run that wrote the cache.
+     */
+    const char                    *cache_path;
+
+    /**
+     * @brief Optional pointer in which to write the dispatch table of the created device (can be NULL)
+     * @note Loaded through the `vkGetDeviceProcAddr` of `vs_instance::dispatch`, so that calls through it go straight
+     *       to the driver.
+     */
+    vs_device_dispatch            *out_dispatch;
+
+    /**
+     * @brief Optional pointer in which to write the memory policy of the created device (can be NULL)
+     * @note Built from `physical_device_info` when given. Budgets are queried if `VK_EXT_memory_budget` is in
+     *       `enable_extensions`.
+     */
+    vs_memory_policy              *out_memory_policy;
+
+    /**
+     * @brief Optional pointer to an arena to initialize for the created device (can be NULL)
+     * @note Configured with the limits of the device, dedicated allocations are enabled with Vulkan 1.1 or
+     *       `VK_KHR_dedicated_allocation` in `enable_extensions`, host pointers are imported with
+     *       `VK_EXT_external_memory_host`. Must be destroyed before the device.
+     */
+    vs_memory_arena               *out_memory_arena;
+
+} vs_device_builder;
+
+/**
+ * @brief Creates a device using the provided information
+ *
+ * @param device_builder The information to create the device
+ * @param instance The instance with which to create the device
+ * @return The device or `VK_NULL_HANDLE` if the device could not be created, or if a requested queue wrapper could not be
+ *         initialized (see `vs_queue_init`)
+ * @note SIDE EFFECTS: The pointers provided in the queue request information will be accessed and modified.
+ *       if the device cannot be created the will not be modified and will remain in their initial state
+ */
+VkDevice vs_device_create(VkPhysicalDevice physical_device, vs_device_builder device_builder, vs_instance instance);
+
+/**
+ * @brief Routine to handle the destruction of a device.
+ * @note You don't really need to use this function unless you passed some allocation callbacks on instance creation. (this function applies them)
+ *
+ * @param device The device to destroy
+ * @param instance The instance with which the device was created
+ */
+void     vs_device_destroy(VkDevice device, vs_instance instance);
+
+// ## QUEUE SUBMISSION
+
+/*
+ * A `vs_queue` lets many threads submit to a single `VkQueue`, which Vulkan requires to be externally synchronized :
+ * producers push their submissions in a lock-free ring, and a single consumer drains it, coalescing everything that
+ * is pending into a single `vkQueueSubmit2` call.
+ */
+
+/**
+ * @brief The number of submissions that can be pending in a `vs_queue`, must be a power of two
+ */
+#ifndef VS_QUEUE_RING_SIZE
+#define VS_QUEUE_RING_SIZE 256
+#endif
+
+typedef struct
+{
+    _Atomic uint64_t    sequence;
+    VkSubmitInfo2       submit;
+    VkFence             fence;
+} vs_queue_cell;
+
+/**
+ * @brief A multi producer, single consumer, submission queue
+ * @note Initialized with `vs_queue_init` or by `vs_device_create`, needs no destruction
+ */
+struct vs_queue
+{
+    VkQueue               vk_queue;
+    PFN_vkQueueSubmit2    submit2;
+
+    /**
+     * @brief The queue submissions are forwarded to, itself unless it shares its `VkQueue` with another `vs_queue`
+     */
+    vs_queue             *target;
+
+    // Written by producers and by the consumer, kept on separate cache lines
+    _Alignas(64) _Atomic uint64_t    enqueue_position;
+    _Alignas(64) uint64_t            dequeue_position;
+    _Alignas(64) _Atomic uint64_t    drained_ticket;
+
+    vs_queue_cell         cells[VS_QUEUE_RING_SIZE];
+};
+
+/**
+ * @brief Initializes a queue wrapper
+ *
+ * @param queue The wrapper to initialize
+ * @param device The device owning the queue, used to get `vkQueueSubmit2` (or `vkQueueSubmit2KHR`)
+ * @param vk_queue The queue to wrap
+ * @return Wether or not the device supports `vkQueueSubmit2`
+ * @note The device must have been created with the `synchronization2` feature enabled, `vs_device_create` does so for
+ *       the wrappers it initializes
+ */
+bool     vs_queue_init(vs_queue *queue, VkDevice device, VkQueue vk_queue);
+
+/**
+ * @brief Initializes a wrapper that forwards everything to another one, e.g. for two requests sharing a `VkQueue`
+ */
+void     vs_queue_init_shared(vs_queue *queue, vs_queue *target);
+
+/**
+ * @brief Pushes a submission, can be called from any thread
+ *
+ * @param queue The queue
+ * @param submit The submission, copied, but the arrays it points to must stay valid until it was drained
+ * @param fence Optional fence to signal, the drain then submits everything up to this submission with this fence
+ * @param[out] out_ticket Optional, where to write a ticket to give to `vs_queue_is_drained`
+ * @return `false` if the ring is full, in which case nothing was pushed and the consumer should be given time to drain
+ */
+bool     vs_queue_submit(vs_queue *queue, const VkSubmitInfo2 *submit, VkFence fence, uint64_t *out_ticket);
+
+/**
+ * @brief Submits all the pending submissions to Vulkan, must only be called by one thread at a time
+ *
+ * @param queue The queue
+ * @param[out] out_submit_count Optional, where to write the number of drained submissions
+ * @return The first error returned by `vkQueueSubmit2`, the drained submissions are lost in that case
+ */
+VkResult vs_queue_drain(vs_queue *queue, uint32_t *out_submit_count);
+
+/**
+ * @brief Wether or not a submission was drained, meaning that the arrays it points to can be reused
+ */
+bool     vs_queue_is_drained(const vs_queue *queue, uint64_t ticket);
+
+// ## UPLOAD RING
+
+/*
+ * A `vs_upload_ring` streams data to buffers and images through a persistently mapped staging ring, usually on a
+ * dedicated transfer queue. Uploads are copied into the ring right away and their copy commands batched, a flush
+ * submits them all in one command buffer and signals a timeline semaphore the consumers wait for. The ring space of
+ * a flush is reused once the semaphore reached its value, without any fence.
+ *
+ * Consecutive uploads to the same buffer are merged into a single `vkCmdCopyBuffer`. Image uploads replace whole
+ * subresources : the image is moved from `VK_IMAGE_LAYOUT_UNDEFINED` to `VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL`, and
+ * to its final layout when flushed.
+ *
+ * When the consumer is in another queue family, and the resources use `VK_SHARING_MODE_EXCLUSIVE`, the flush releases
+ * their ownership, and `vs_upload_ring_record_acquire` records the matching acquire in a command buffer of the
+ * consumer.
+ *
+ * Upload rings are not thread safe, their submissions are if they go through a `vs_queue`.
+ */
+
+#ifndef VS_UPLOAD_RING_SIZE
+#define VS_UPLOAD_RING_SIZE (32ull << 20)
+#endif
+
+/**
+ * @brief The number of flushes an upload ring can have in flight, before waiting for the oldest one
+ */
+#ifndef VS_UPLOAD_RING_FRAMES
+#define VS_UPLOAD_RING_FRAMES 3
+#endif
+
+/**
+ * @brief The number of buffer copies merged into one `vkCmdCopyBuffer`, and of barriers a flush can hold
+ */
+#ifndef VS_UPLOAD_RING_MAX_REGIONS
+#define VS_UPLOAD_RING_MAX_REGIONS 256
+#endif
+
+#ifndef VS_UPLOAD_RING_MAX_BARRIERS
+#define VS_UPLOAD_RING_MAX_BARRIERS 128
+#endif
+
+typedef struct
+{
+    /**
+     * @brief The size of the staging ring, `VS_UPLOAD_RING_SIZE` if zero
+     */
+    VkDeviceSize    size;
+
+    /**
+     * @brief The queue the copies are submitted to, and its family
+     */
+    VkQueue         queue;
+    uint32_t        queue_family_index;
+
+    /**
+     * @brief Optional, the wrapper of `queue` to submit through, when other threads submit to it
+     */
+    vs_queue       *wrapper;
+
+    /**
+     * @brief The family of the queue using the uploaded resources, `VK_QUEUE_FAMILY_IGNORED` (or
+     *        `queue_family_index`) if there is no ownership to transfer
+     */
+    uint32_t        consumer_family_index;
+
+    /**
+     * @brief The `nonCoherentAtomSize` limit of the device, 256 (the largest allowed) if zero
+     */
+    VkDeviceSize    non_coherent_atom_size;
+} vs_upload_ring_info;
+
+/**
+ * @brief Counters of an upload ring, since it was initialized
+ */
+typedef struct
+{
+    uint64_t        uploads;
+    VkDeviceSize    bytes;
+    uint64_t        flushes;
+
+    /**
+     * @brief The copy commands recorded, less than the uploads when copies were merged
+     */
+    uint64_t        copy_commands;
+
+    /**
+     * @brief The times a flush had to wait for the GPU, as `VS_UPLOAD_RING_FRAMES` flushes were in flight
+     */
+    uint64_t        stalls;
+} vs_upload_ring_stats;
+
+typedef struct
+{
+    vs_memory_arena            *arena;
+    vs_upload_ring_info         info;
+
+    vs_memory_linear            staging;
+    VkBuffer                    staging_buffer;
+    bool                        coherent;
+
+    /**
+     * @brief The timeline semaphore signaled by the flushes, consumers wait for the value `vs_upload_ring_flush` gives
+     */
+    VkSemaphore                 timeline;
+    uint64_t                    flushed_value;
+    uint64_t                    released_value;
+
+    // One command buffer per flush in flight, with the ring position at the end of its uploads
+    VkCommandPool               command_pools[VS_UPLOAD_RING_FRAMES];
+    VkCommandBuffer             command_buffers[VS_UPLOAD_RING_FRAMES];
+    uint64_t                    flush_marks[VS_UPLOAD_RING_FRAMES];
+    bool                        recording;
+    uint64_t                    batch_start;
+
+    // Kept in the ring, as a `vs_queue` reads them once drained
+    VkCommandBufferSubmitInfo   command_buffer_infos[VS_UPLOAD_RING_FRAMES];
+    VkSemaphoreSubmitInfo       signal_infos[VS_UPLOAD_RING_FRAMES];
+    VkSubmitInfo2               submit_infos[VS_UPLOAD_RING_FRAMES];
+
+    // The copies from `region_source` to `region_buffer` not recorded yet
+    VkBuffer                    region_source;
+    VkBuffer                    region_buffer;
+    uint32_t                    region_count;
+    VkBufferCopy                regions[VS_UPLOAD_RING_MAX_REGIONS];
+
+    // The barriers of the batch being recorded first, of the last flush second
+    VkBufferMemoryBarrier2     *buffer_barriers[2];
+    VkImageMemoryBarrier2      *image_barriers[2];
+    uint32_t                    buffer_barrier_counts[2];
+    uint32_t                    image_barrier_counts[2];
+
+    vs_upload_ring_stats        stats;
+} vs_upload_ring;
+
+/**
+ * @brief Initializes an upload ring
+ *
+ * @param[out] ring The ring
+ * @param arena The arena the staging memory is allocated from, with `VS_MEMORY_USAGE_STAGING`
+ * @param info The configuration of the ring
+ * @return Wether or not every object of the ring could be created, the device must support timeline semaphores and
+ *         `synchronization2`
+ */
+bool vs_upload_ring_init(vs_upload_ring *ring, vs_memory_arena *arena, vs_upload_ring_info info);
+
+/**
+ * @brief Waits for the flushes in flight and destroys the ring, the uploads not flushed are lost
+ */
+void vs_upload_ring_destroy(vs_upload_ring *ring);
+
+/**
+ * @brief Uploads data to a buffer
+ *
+ * @param ring The ring
+ * @param buffer The destination, created with `VK_BUFFER_USAGE_TRANSFER_DST_BIT`
+ * @param offset Where to write in the destination
+ * @param data The data, copied before returning
+ * @param size The size of the data
+ * @return `false` if the ring has no room left, in which case it should be flushed (or waited for) before retrying
+ */
+bool vs_upload_ring_buffer(vs_upload_ring *ring, VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+
+/**
+ * @brief Uploads data to a subresource of an image, whose previous content is discarded
+ *
+ * @param ring The ring
+ * @param image The destination, created with `VK_IMAGE_USAGE_TRANSFER_DST_BIT`
+ * @param region Where to write in the image, `bufferOffset` is ignored
+ * @param texel_block_size The size in bytes of a texel block of the image format (of the copied aspect), e.g. 12 for
+ *        `VK_FORMAT_R32G32B32_SFLOAT`, the staged texels are aligned to it
+ * @param final_layout The layout the image is in once the flush completed
+ * @param data The texels, laid out as `region` describes
+ * @param size The size of the texels
+ * @return `false` if the ring has no room left (or no room for the barrier), see `vs_upload_ring_buffer`
+ */
+bool vs_upload_ring_image(vs_upload_ring *ring, VkImage image, const VkBufferImageCopy *region, VkDeviceSize texel_block_size,
+                          VkImageLayout final_layout, const void *data, VkDeviceSize size);
+
+/**
+ * @brief Copies data already in a staging buffer to a buffer, along with the uploads of the next flush
+ *
+ * @param ring The ring
+ * @param source The buffer holding the data, e.g. written by the host or read from a file
+ * @param source_offset The offset of the data in `source`
+ * @param buffer The destination buffer
+ * @param offset The offset of the data in `buffer`
+ * @param size The size of the data
+ * @param[out] out_batch_full Optional, set to wether the copy was refused because the batch has no room left for its
+ *             barrier, in which case it can be retried after `vs_upload_ring_flush`
+ * @return Wether or not the copy could be recorded, the source must stay untouched until the ring reaches
+ *         `flushed_value + 1`, the value of the next flush
+ */
+bool vs_upload_ring_copy(vs_upload_ring *ring, VkBuffer source, VkDeviceSize source_offset, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                         bool *out_batch_full);
+
+/**
+ * @brief Submits the uploads recorded since the last flush
+ *
+ * @param ring The ring
+ * @param[out] out_value Optional, where to write the timeline value signaled once the uploads completed
+ * @return Wether or not the submission succeeded, nothing is submitted if there was nothing to upload
+ */
+bool vs_upload_ring_flush(vs_upload_ring *ring, uint64_t *out_value);
+
+/**
+ * @brief Gets the last timeline value reached, and reuses the ring space of the completed flushes
+ */
+uint64_t vs_upload_ring_completed_value(vs_upload_ring *ring);
+
+/**
+ * @brief Records the ownership acquire of the resources of the last flush, on the consumer queue
+ * @note The command buffer must be submitted waiting for the value of the flush, and before the next flush. Does
+ *       nothing if there is no ownership transfer.
+ */
+void vs_upload_ring_record_acquire(const vs_upload_ring *ring, VkCommandBuffer command_buffer);
+
+// ## FILE BUFFERS
+
+/*
+ * A `vs_file_buffer` exposes the content of a read-only file (meshes, volumes, weights ...) to the GPU as a buffer.
+ *
+ * With `VK_EXT_external_memory_host`, the file is mapped and the mapping is imported as device memory : the GPU copies
+ * or reads straight from the page cache, and the file is never copied by the CPU. The mapping is aligned to
+ * `minImportedHostPointerAlignment` and padded with zeros up to a multiple of it.
+ *
+ * Without the extension, or if the driver refuses the mapping, the file is read into a host visible allocation of the
+ * arena instead.
+ */
+
+typedef struct
+{
+    /**
+     * @brief The buffer holding the file from offset 0, of the size of the file
+     */
+    VkBuffer                buffer;
+    VkDeviceSize            size;
+
+    /**
+     * @brief The content of the file on the host, read-only
+     */
+    const void             *data;
+
+    /**
+     * @brief Wether or not the buffer is the imported file mapping, rather than a copy of the file
+     */
+    bool                    imported;
+
+    // The imported mapping, or the allocation of the copy
+    void                   *mapping;
+    size_t                  mapping_size;
+    VkDeviceMemory          memory;
+    uint32_t                type_index;
+    vs_memory_allocation    allocation;
+} vs_file_buffer;
+
+/**
+ * @brief Opens a file as a buffer, importing its mapping if possible
+ *
+ * @param arena The arena the memory is accounted to, or allocated from when the mapping cannot be imported
+ * @param path The path of the file
+ * @param usage The usage of the buffer, `VK_BUFFER_USAGE_TRANSFER_SRC_BIT` is always added
+ * @param[out] out_file Where to write the file buffer
+ * @return Wether or not the file could be read and the buffer created
+ * @note Requires a POSIX platform. Empty files are refused.
+ */
+bool vs_file_buffer_open(vs_memory_arena *arena, const char *path, VkBufferUsageFlags usage, vs_file_buffer *out_file);
+
+/**
+ * @brief Destroys the buffer of a file and releases its memory
+ * @note The GPU must be done with the buffer.
+ */
+void vs_file_buffer_close(vs_memory_arena *arena, vs_file_buffer *file);
+
+// ## STREAMING LOADER
+
+/*
+ * A `vs_stream_loader` reads files straight into mapped staging memory and copies them to buffers through an upload
+ * ring, so that no thread blocks on a `read` before the data can reach the GPU.
+ *
+ * The staging memory is split in `queue_depth` chunks, each holding one read. On Linux, reads are batched in an
+ * io_uring submission queue, otherwise (or if the kernel refuses io_uring) a pool of threads calls `pread`. Completed
+ * reads are copied with `vs_upload_ring_copy`, and their chunk is reused once the flush carrying the copy completed.
+ *
+ * Files are opened with `O_DIRECT` where the file system allows it, skipping the page cache : reads are then aligned
+ * to `VS_STREAM_DIRECT_ALIGNMENT`, and the copies start at the requested offset within the chunk.
+ *
+ * Streaming loaders are not thread safe, and share the thread safety of their upload ring.
+ */
+
+#ifndef VS_STREAM_QUEUE_DEPTH
+#define VS_STREAM_QUEUE_DEPTH 32
+#endif
+
+#ifndef VS_STREAM_CHUNK_SIZE
+#define VS_STREAM_CHUNK_SIZE (1ull << 20)
+#endif
+
+/**
+ * @brief The number of reads that can be requested before `vs_stream_loader_finish`, each can span many chunks
+ */
+#ifndef VS_STREAM_MAX_REQUESTS
+#define VS_STREAM_MAX_REQUESTS 1024
+#endif
+
+/**
+ * @brief The alignment of the offsets, sizes and addresses of `O_DIRECT` reads, the logical block size of most drives
+ */
+#ifndef VS_STREAM_DIRECT_ALIGNMENT
+#define VS_STREAM_DIRECT_ALIGNMENT 4096
+#endif
+
+#ifndef VS_STREAM_MAX_THREADS
+#define VS_STREAM_MAX_THREADS 16
+#endif
+
+typedef struct
+{
+    /**
+     * @brief The number of reads in flight, and of staging chunks, `VS_STREAM_QUEUE_DEPTH` if zero
+     */
+    uint32_t        queue_depth;
+
+    /**
+     * @brief The size of the chunks, `VS_STREAM_CHUNK_SIZE` if zero, rounded up to `VS_STREAM_DIRECT_ALIGNMENT`
+     */
+    VkDeviceSize    chunk_size;
+
+    /**
+     * @brief Wether or not to open files with `O_DIRECT`
+     */
+    bool            direct_io;
+
+    /**
+     * @brief Wether or not to use the `pread` threads even if io_uring is available
+     */
+    bool            disable_io_uring;
+
+    /**
+     * @brief The number of `pread` threads, 4 if zero, at most `VS_STREAM_MAX_THREADS`
+     */
+    uint32_t        thread_count;
+} vs_stream_loader_info;
+
+/**
+ * @brief Counters of a streaming loader, since it was initialized
+ */
+typedef struct
+{
+    uint64_t        requests;
+    uint64_t        reads;
+    VkDeviceSize    bytes;
+
+    /**
+     * @brief The reads made with `O_DIRECT`, and the ones resubmitted because the kernel returned less than asked
+     */
+    uint64_t        direct_reads;
+    uint64_t        short_reads;
+    uint64_t        errors;
+
+    /**
+     * @brief The queue depth, sampled at each submission : the average is `depth_sum / depth_samples`
+     */
+    uint32_t        max_depth;
+    uint64_t        depth_sum;
+    uint64_t        depth_samples;
+
+    /**
+     * @brief The time during which reads were in flight, the throughput is `bytes / busy_ns`
+     */
+    uint64_t        busy_ns;
+
+    /**
+     * @brief The times a read waited for a chunk still read by the GPU
+     */
+    uint64_t        chunk_stalls;
+} vs_stream_loader_stats;
+
+/**
+ * @brief A file opened for streaming
+ */
+typedef struct
+{
+    int     fd;
+    bool    direct;
+} vs_stream_file;
+
+typedef struct vs_stream_loader vs_stream_loader;
+typedef struct _vs_stream_pool _vs_stream_pool;
+typedef struct _vs_stream_uring _vs_stream_uring;
+
+typedef struct
+{
+    vs_stream_file    file;
+    uint64_t          file_offset;
+    VkDeviceSize      size;
+    VkBuffer          buffer;
+    VkDeviceSize      buffer_offset;
+} _vs_stream_request;
+
+typedef struct
+{
+    uint32_t        state;
+    bool            direct;
+    int             fd;
+
+    // The read, and where its data goes once read
+    uint64_t        file_offset;
+    VkDeviceSize    length;
+    VkDeviceSize    done;
+    VkDeviceSize    skip;
+    VkDeviceSize    size;
+    VkBuffer        buffer;
+    VkDeviceSize    buffer_offset;
+
+    /**
+     * @brief The value of the flush copying the chunk, it can be reused once the upload ring reached it
+     */
+    uint64_t        value;
+} _vs_stream_chunk;
+
+struct vs_stream_loader
+{
+    vs_upload_ring             *ring;
+    vs_stream_loader_info       info;
+
+    /**
+     * @brief Wether or not reads go through io_uring, rather than `pread` threads
+     */
+    bool                        io_uring;
+
+    vs_memory_allocation        staging;
+    VkBuffer                    staging_buffer;
+    bool                        coherent;
+    _vs_stream_chunk           *chunks;
+
+    // The requests not entirely given to chunks yet, in order
+    _vs_stream_request         *requests;
+    uint32_t                    request_head;
+    uint32_t                    request_count;
+
+    uint32_t                    in_flight;
+    uint64_t                    busy_start;
+
+    /**
+     * @brief Wether or not a read failed since the last `vs_stream_loader_finish`
+     */
+    bool                        failed;
+
+    _vs_stream_uring           *uring;
+    _vs_stream_pool            *pool;
+
+    vs_stream_loader_stats      stats;
+};
+
+/**
+ * @brief Initializes a streaming loader
+ *
+ * @param[out] loader The loader
+ * @param ring The upload ring the copies go through, and whose arena the staging memory comes from
+ * @param info The configuration of the loader
+ * @return Wether or not the staging memory, and io_uring or the threads, could be set up
+ * @note Requires a POSIX platform. The threads keep a pointer to the loader, which must not move while initialized.
+ */
+bool vs_stream_loader_init(vs_stream_loader *loader, vs_upload_ring *ring, vs_stream_loader_info info);
+
+/**
+ * @brief Waits for the reads in flight and destroys the loader, the requests not read yet are dropped
+ */
+void vs_stream_loader_destroy(vs_stream_loader *loader);
+
+/**
+ * @brief Opens a file for streaming, with `O_DIRECT` if the loader asks for it and the file system supports it
+ * @return Wether or not the file could be opened
+ */
+bool vs_stream_file_open(const vs_stream_loader *loader, const char *path, vs_stream_file *out_file);
+
+void vs_stream_file_close(vs_stream_file *file);
+
+/**
+ * @brief Requests a range of a file to be read into a buffer
+ *
+ * @param loader The loader
+ * @param file The file, which must stay open until the read is copied
+ * @param file_offset The offset of the range in the file
+ * @param size The size of the range
+ * @param buffer The destination buffer
+ * @param buffer_offset The offset of the range in `buffer`
+ * @return Wether or not the request could be queued, `VS_STREAM_MAX_REQUESTS` are queued at most
+ */
+bool vs_stream_loader_read(vs_stream_loader *loader, const vs_stream_file *file, uint64_t file_offset, VkDeviceSize size, VkBuffer buffer, VkDeviceSize buffer_offset);
+
+/**
+ * @brief Advances the reads without blocking : submits requests to the free chunks, copies the completed reads, and
+ *        flushes the upload ring when every chunk waits for it
+ * @return Wether or not any request is left to read or copy
+ */
+bool vs_stream_loader_poll(vs_stream_loader *loader);
+
+/**
+ * @brief Reads every request, and flushes the upload ring
+ *
+ * @param loader The loader
+ * @param[out] out_value Optional, where to write the timeline value of the upload ring signaled once every request
+ *                       reached its buffer
+ * @return Wether or not every read succeeded
+ */
+bool vs_stream_loader_finish(vs_stream_loader *loader, uint64_t *out_value);
+
+// ## COMMAND POOLS
+
+/*
+ * A `vs_command_pool_set` gives each recording thread, and each frame in flight, its own transient command pool, so
+ * that command buffers are handed out without any lock. Command buffers are never freed : when a frame comes around
+ * again, the pool of each thread is reset as a whole with `vkResetCommandPool`, and its command buffers handed out
+ * anew.
+ *
+ * Sets are created per queue family, from the `vs_queue_assignment::family_index` given by `vs_device_create`, and
+ * requests assigned the same family can share a set.
+ *
+ * A thread index must only be used by one thread at a time. `vs_command_pool_set_advance` is called by a single thread,
+ * when no other thread records.
+ */
+
+#ifndef VS_COMMAND_POOL_FRAMES
+#define VS_COMMAND_POOL_FRAMES 2
+#endif
+
+/**
+ * @brief The number of command buffers of each level a thread can use in a frame
+ */
+#ifndef VS_COMMAND_POOL_MAX_BUFFERS
+#define VS_COMMAND_POOL_MAX_BUFFERS 64
+#endif
+
+/**
+ * @brief The number of command buffers allocated at once when a pool runs out of them
+ */
+#ifndef VS_COMMAND_POOL_ALLOCATION_BATCH
+#define VS_COMMAND_POOL_ALLOCATION_BATCH 8
+#endif
+
+typedef struct
+{
+    VkDevice                        device;
+    const VkAllocationCallbacks    *allocation_callbacks;
+
+    /**
+     * @brief The family of the queues the command buffers are submitted to
+     */
+    uint32_t                        queue_family_index;
+
+    /**
+     * @brief The number of recording threads, each gets a pool per frame
+     */
+    uint32_t                        thread_count;
+
+    /**
+     * @brief The number of frames in flight, `VS_COMMAND_POOL_FRAMES` if zero
+     */
+    uint32_t                        frame_count;
+
+    /**
+     * @brief Additional flags of the pools (e.g. `VK_COMMAND_POOL_CREATE_PROTECTED_BIT`), they are always transient
+     */
+    VkCommandPoolCreateFlags        flags;
+} vs_command_pool_set_info;
+
+/**
+ * @brief The pool of a thread for a frame, only touched by that thread
+ */
+typedef struct
+{
+    // Kept on its own cache lines, as threads update their pool all the time
+    _Alignas(64) VkCommandPool      pool;
+
+    /**
+     * @brief The frame the command buffers were last handed out in, the pool is reset when it changes
+     */
+    uint64_t                        frame;
+
+    // Per level, the command buffers allocated from Vulkan and the ones handed out this frame
+    uint32_t                        allocated_counts[2];
+    uint32_t                        used_counts[2];
+    VkCommandBuffer                 command_buffers[2][VS_COMMAND_POOL_MAX_BUFFERS];
+
+    uint64_t                        handed_out;
+    uint64_t                        resets;
+} vs_command_pool;
+
+/**
+ * @brief Counters of a command pool set, since it was initialized
+ */
+typedef struct
+{
+    /**
+     * @brief The command buffers given by `vs_command_pool_set_allocate`
+     */
+    uint64_t    handed_out;
+
+    /**
+     * @brief The command buffers allocated from Vulkan, at most `VS_COMMAND_POOL_MAX_BUFFERS` per pool and level
+     */
+    uint64_t    allocated;
+    uint64_t    resets;
+} vs_command_pool_set_stats;
+
+typedef struct
+{
+    vs_command_pool_set_info    info;
+
+    /**
+     * @brief The current frame, its pools are the ones of index `frame % frame_count`
+     */
+    uint64_t                    frame;
+
+    /**
+     * @brief The thread indices given by `vs_command_pool_set_register_thread`
+     */
+    _Atomic uint32_t            registered_threads;
+
+    /**
+     * @brief The pools of every frame, `thread_count` of them per frame
+     */
+    vs_command_pool            *pools;
+    void                       *pool_memory;
+} vs_command_pool_set;
+
+/**
+ * @brief Creates the pools of a set
+ *
+ * @param[out] set The set
+ * @param info The configuration of the set
+ * @return Wether or not every pool could be created
+ */
+bool            vs_command_pool_set_init(vs_command_pool_set *set, vs_command_pool_set_info info);
+
+/**
+ * @brief Destroys the pools of a set, and their command buffers
+ * @note None of the command buffers may still be pending on the GPU.
+ */
+void            vs_command_pool_set_destroy(vs_command_pool_set *set);
+
+/**
+ * @brief Gives the calling thread the next unused thread index, can be called from any thread
+ * @return The index, or `UINT32_MAX` if `thread_count` indices were already given
+ */
+uint32_t        vs_command_pool_set_register_thread(vs_command_pool_set *set);
+
+/**
+ * @brief Begins the next frame, whose pools are reset as their threads get their first command buffer
+ *
+ * @param set The set
+ * @return The new frame
+ * @note The command buffers handed out `frame_count` frames earlier must have completed on the GPU, e.g. by waiting
+ *       for the fence of that frame.
+ */
+uint64_t        vs_command_pool_set_advance(vs_command_pool_set *set);
+
+/**
+ * @brief Hands out a command buffer of the current frame, to be recorded by the calling thread
+ *
+ * @param set The set
+ * @param thread_index The index of the calling thread, lower than `thread_count`
+ * @param level The level of the command buffer
+ * @return The command buffer, in the initial state, or `VK_NULL_HANDLE` if the thread used `VS_COMMAND_POOL_MAX_BUFFERS`
+ *         of them in this frame or the allocation failed
+ */
+VkCommandBuffer vs_command_pool_set_allocate(vs_command_pool_set *set, uint32_t thread_index, VkCommandBufferLevel level);
+
+/**
+ * @brief Sums the counters of every pool, must not be called while threads record
+ */
+void            vs_command_pool_set_stats_get(const vs_command_pool_set *set, vs_command_pool_set_stats *out_stats);
+
+// ## BOOTSTRAP
+
+/*
+ * The bootstrap runs `vs_instance_builder_build`, the physical device selection and `vs_device_create` on a worker
+ * thread, so that the application can do something else (e.g. load its assets) while the driver initializes. The
+ * physical devices are probed in parallel during the selection.
+ *
+ * Without threads (i.e. not on a unix-like platform) everything runs in `vs_bootstrap_start`.
+ */
+
+#if !defined(VS_BOOTSTRAP_ASYNC) && ( defined(__unix__) || defined(__APPLE__) )
+#define VS_BOOTSTRAP_ASYNC
+#endif
+#ifdef VS_BOOTSTRAP_ASYNC
+#include <pthread.h>
+#endif
+
+#ifndef VS_BOOTSTRAP_MAX_PROBE_THREADS
+#define VS_BOOTSTRAP_MAX_PROBE_THREADS 8
+#endif
+
+/**
+ * @brief The stack size of the bootstrap worker and probe threads, which hold physical device information snapshots
+ */
+#ifndef VS_BOOTSTRAP_STACK_SIZE
+#define VS_BOOTSTRAP_STACK_SIZE ( 2 * sizeof(vs_physical_device_info) + (1u << 20) )
+#endif
+
+typedef enum
+{
+    VS_BOOTSTRAP_PENDING = 0,
+    VS_BOOTSTRAP_SUCCESS,
+    VS_BOOTSTRAP_INSTANCE_FAILED,
+    VS_BOOTSTRAP_NO_SUITABLE_DEVICE,
+    VS_BOOTSTRAP_DEVICE_FAILED,
+} vs_bootstrap_status;
+
+/**
+ * @brief What to bootstrap
+ * @note Everything the builders and the selector point to (names, queue requests, destinations ...) must stay valid
+ *       until the bootstrap is done.
+ */
+typedef struct
+{
+    vs_instance_builder            instance_builder;
+    vs_physical_device_selector    selector;
+
+    /**
+     * @brief The device to create, `vs_device_builder::physical_device_info` is set by the bootstrap
      */
-    VkPhysicalDeviceType    preferred_type;
+    vs_device_builder              device_builder;
 
-} vs_physical_device_selector;
+    /**
+     * @brief The number of threads probing physical devices, one per device (up to `VS_BOOTSTRAP_MAX_PROBE_THREADS`)
+     *        if zero
+     */
+    uint32_t                       probe_thread_count;
+} vs_bootstrap_info;
+
+/**
+ * @brief A bootstrap in progress, its results can be read once `vs_bootstrap_poll` or `vs_bootstrap_wait` returned
+ *        something else than `VS_BOOTSTRAP_PENDING`
+ * @note Holds a `vs_physical_device_info`, so it should rather not be on the stack.
+ */
+typedef struct
+{
+    vs_bootstrap_info          bootstrap_info;
 
+    /**
+     * @brief The results, the instance is destroyed if the bootstrap failed after creating it
+     */
+    vs_instance                instance;
+    VkPhysicalDevice           physical_device;
+    VkDevice                   device;
+    vs_physical_device_info    physical_device_info;
+
+    _Atomic uint32_t           status;
+#ifdef VS_BOOTSTRAP_ASYNC
+    pthread_t                  thread;
+    bool                       joined;
+#endif
+} vs_bootstrap;
 
 /**
- * @brief Selects a suitable physical device based on the specified selecion criteria
+ * @brief Starts a bootstrap
  *
- * @param selector The selector
- * @return A suitable physical device or `VK_NULL_HANDLE` if no suitable device was found.
+ * @param bootstrap Where to run the bootstrap, must stay valid until it is done
+ * @param info What to bootstrap
+ * @return Wether or not the bootstrap could be started, `false` only if the worker thread could not be created
  */
-VkPhysicalDevice vs_select_physical_device(vs_physical_device_selector selector, vs_instance instance);
+bool                vs_bootstrap_start(vs_bootstrap *bootstrap, vs_bootstrap_info info);
 
-// ## DEVICE CREATION
+/**
+ * @brief Gets the status of a bootstrap without blocking
+ */
+vs_bootstrap_status vs_bootstrap_poll(vs_bootstrap *bootstrap);
+
+/**
+ * @brief Waits for a bootstrap to be done, must only be called by one thread at a time
+ */
+vs_bootstrap_status vs_bootstrap_wait(vs_bootstrap *bootstrap);
+
+// ## DEBUG MESSENGER
+
+/*
+ * A `vs_debug_messenger` takes validation messages off the threads that trigger them : `vs_debug_messenger_callback`
+ * copies each message into a lock-free ring, and `vs_debug_messenger_drain` hands them to a sink, from a background
+ * thread started with `vs_debug_messenger_start` or from wherever the application calls it.
+ *
+ * Repeats are rate limited per `messageIdNumber` before reaching the ring : past `max_repeats` messages of an id in a
+ * window, the others are only counted, and the next one delivered carries that count. The counts are approximate when
+ * many threads report the same id at the same time.
+ *
+ * The draining thread is only available with `VS_DEBUG_MESSENGER_THREAD`, defined on unix-like platforms like
+ * `VS_BOOTSTRAP_ASYNC` but independently from it.
+ */
+
+#if !defined(VS_DEBUG_MESSENGER_THREAD) && ( defined(__unix__) || defined(__APPLE__) )
+#define VS_DEBUG_MESSENGER_THREAD
+#endif
+#ifdef VS_DEBUG_MESSENGER_THREAD
+#include <pthread.h>
+#endif
+
+/**
+ * @brief The number of messages that can wait in a `vs_debug_messenger`, must be a power of two
+ */
+#ifndef VS_DEBUG_MESSENGER_RING_SIZE
+#define VS_DEBUG_MESSENGER_RING_SIZE 256
+#endif
+
+/**
+ * @brief The number of message ids that are rate limited, must be a power of two. Ids past it are never limited.
+ */
+#ifndef VS_DEBUG_MESSENGER_ID_SLOTS
+#define VS_DEBUG_MESSENGER_ID_SLOTS 256
+#endif
+
+/**
+ * @brief The size of the message copies, longer messages are truncated
+ */
+#ifndef VS_DEBUG_MESSAGE_MAX_LENGTH
+#define VS_DEBUG_MESSAGE_MAX_LENGTH 1024
+#endif
 
 typedef struct
 {
+    VkDebugUtilsMessageSeverityFlagBitsEXT    severity;
+    VkDebugUtilsMessageTypeFlagsEXT           type;
+    int32_t                                   message_id;
+
     /**
-     * @brief The number of queues to request
+     * @brief The number of messages with this id that were suppressed since the previous one was delivered
      */
-    uint32_t            queue_request_count;
+    uint32_t                                  repeat_count;
+    char                                      message[VS_DEBUG_MESSAGE_MAX_LENGTH];
+} vs_debug_message;
 
+/**
+ * @brief Receives the drained messages, on the draining thread
+ */
+typedef void (*vs_debug_message_sink)(const vs_debug_message *message, void *udata);
+
+typedef struct
+{
     /**
-     * @brief A pointer to a list of queue requests struct, with valid pointers in the `vs_queue_request::destination` field.
+     * @brief The number of messages of a same id delivered per window, 0 for `VS_DEBUG_MESSENGER_DEFAULT_MAX_REPEATS`
      */
-    vs_queue_request   *queue_requests;
+    uint32_t                 max_repeats;
 
     /**
-     * @brief Wether or not to request a present queue
+     * @brief The length of the rate limiting windows in milliseconds, 0 for one second
      */
-    bool                request_present_queue;
+    uint32_t                 window_ms;
 
     /**
-     * @brief The surface with which to query for the present queue. Cannot be `VK_NULL_HANDLE` unless `request_present_queue` is `false`
+     * @brief How often the background thread drains the ring in milliseconds, 0 for 10
      */
-    VkSurfaceKHR        surface;
+    uint32_t                 drain_interval_ms;
 
     /**
-     * @brief Where to write the gotten present queue. Cannot be `VK_NULL_HANDLE` unless `request_present_queue` is `false`
-     * @note The present queue can be selected amongst the previously acquired queue, but this is not necessary.
+     * @brief Where the messages go, if NULL they are printed to stdout
      */
-    VkQueue                    *present_destination;
+    vs_debug_message_sink    sink;
+    void                    *sink_udata;
+} vs_debug_messenger_info;
+
+#define VS_DEBUG_MESSENGER_DEFAULT_MAX_REPEATS 4
+
+typedef struct
+{
+    _Atomic uint64_t    sequence;
+    vs_debug_message    message;
+} vs_debug_message_cell;
 
+typedef struct
+{
     /**
-     * @brief The features to enable on the device.
+     * @brief The message id + 1 owning the slot, 0 if the slot is free
      */
-    VkPhysicalDeviceFeatures    features;
+    _Atomic int64_t     key;
+    _Atomic uint64_t    window_start;
+    _Atomic uint32_t    count;
+    _Atomic uint32_t    suppressed;
+} vs_debug_message_id_slot;
 
+/**
+ * @brief The counters of a `vs_debug_messenger`
+ */
+typedef struct
+{
     /**
-     * @brief The amount of extensions to enable
+     * @brief Messages pushed to the ring
      */
-    uint32_t                    enable_extension_count;
+    uint64_t    pushed;
 
     /**
-     * @brief A pointer to a list of string literals of extensions to enable on the device.
+     * @brief Messages given to the sink
      */
-    char                      **enable_extensions;
+    uint64_t    delivered;
 
-} vs_device_builder;
+    /**
+     * @brief Messages lost because the ring was full
+     */
+    uint64_t    dropped;
+
+    /**
+     * @brief Messages not pushed because their id was rate limited
+     */
+    uint64_t    suppressed;
+} vs_debug_messenger_stats;
 
 /**
- * @brief Creates a device using the provided information
+ * @brief A multi producer, single consumer, validation message queue
+ * @note Large (see `VS_DEBUG_MESSENGER_RING_SIZE`), better not put on the stack
+ */
+typedef struct
+{
+    vs_debug_messenger_info     info;
+
+    // Written by producers and by the consumer, kept on separate cache lines
+    _Alignas(64) _Atomic uint64_t    enqueue_position;
+    _Alignas(64) uint64_t            dequeue_position;
+    uint64_t                         delivered;
+    _Alignas(64) _Atomic uint64_t    dropped;
+    _Atomic uint64_t                 suppressed;
+
+    vs_debug_message_id_slot    ids[VS_DEBUG_MESSENGER_ID_SLOTS];
+    vs_debug_message_cell       cells[VS_DEBUG_MESSENGER_RING_SIZE];
+
+#ifdef VS_DEBUG_MESSENGER_THREAD
+    pthread_t                   thread;
+    bool                        thread_started;
+    _Atomic bool                stop;
+#endif
+} vs_debug_messenger;
+
+/**
+ * @brief Initializes a messenger, which can receive messages right away
+ */
+void     vs_debug_messenger_init(vs_debug_messenger *messenger, vs_debug_messenger_info info);
+
+/**
+ * @brief Starts a thread draining the messenger every `drain_interval_ms`
  *
- * @param device_builder The information to create the device
- * @param instance The instance with which to create the device
- * @return The device or `VK_NULL_HANDLE` if the device could not be created
- * @note SIDE EFFECTS: The pointers provided in the queue request information will be accessed and modified.
- *       if the device cannot be created the will not be modified and will remain in their initial state
+ * @return Wether or not the thread was started, `vs_debug_messenger_drain` has to be called by the application if not
  */
-VkDevice vs_device_create(VkPhysicalDevice physical_device, vs_device_builder device_builder, vs_instance instance);
+bool     vs_debug_messenger_start(vs_debug_messenger *messenger);
 
 /**
- * @brief Routine to handle the destruction of a device.
- * @note You don't really need to use this function unless you passed some allocation callbacks on instance creation. (this function applies them)
+ * @brief Stops the draining thread if any, and delivers the messages that are left
+ * @note Call it after `vs_instance_destroy`, as the validation layers report leaks when the instance is destroyed
+ */
+void     vs_debug_messenger_stop(vs_debug_messenger *messenger);
+
+/**
+ * @brief Gives all the pending messages to the sink, must only be called by one thread at a time
  *
- * @param device The device to destroy
- * @param instance The instance with which the device was created
+ * @return The number of delivered messages
  */
-void     vs_device_destroy(VkDevice device, vs_instance instance);
+uint32_t vs_debug_messenger_drain(vs_debug_messenger *messenger);
+
+/**
+ * @brief Gets the counters of the messenger, can be called from any thread
+ * @note `delivered` is only up to date on the draining thread
+ */
+vs_debug_messenger_stats vs_debug_messenger_stats_get(vs_debug_messenger *messenger);
+
+/**
+ * @brief A debug utils callback pushing to the `vs_debug_messenger` given as user data, never blocks
+ * @note Give it as `vs_instance_builder::messenger_callback`, with the messenger as `messenger_user_data`
+ */
+VKAPI_ATTR VkBool32 VKAPI_CALL vs_debug_messenger_callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT *callback_data, void *user_data);
 
 // ## FORMAT STUFF
 
@@ -305,15 +2900,105 @@ typedef struct
 
 /**
  * @brief Represents a query for a format
+ * @note The flags are `VkFormatFeatureFlags2`, whose 32 first bits match `VkFormatFeatureFlags`. The features past them
+ *       are only known to a `vs_format_table` built with `VkFormatProperties3`, other queries never find them.
  */
 typedef struct
 {
-    VkFormatFeatureFlags    required_linear_tiling_features;
-    VkFormatFeatureFlags    required_optimal_tiling_features;
-    VkFormatFeatureFlags    required_buffer_features;
+    VkFormatFeatureFlags2    required_linear_tiling_features;
+    VkFormatFeatureFlags2    required_optimal_tiling_features;
+    VkFormatFeatureFlags2    required_buffer_features;
 } vs_format_query;
 
-// TODO: Add useful format sets like : RGB, RGBA ...
+/**
+ * @brief The features supported by a format
+ */
+typedef struct
+{
+    VkFormatFeatureFlags2    linear_tiling_features;
+    VkFormatFeatureFlags2    optimal_tiling_features;
+    VkFormatFeatureFlags2    buffer_features;
+} vs_format_features;
+
+/**
+ * @brief The built-in format sets, see `vs_format_set_get`
+ * @note Formats are in order of preference : the formats using the less memory and bandwidth come first, so a query on
+ *       a set finds the most compact format that fits. Compressed sets only hold 8 bits per texel RGBA formats, most
+ *       precise first.
+ */
+typedef enum
+{
+    /**
+     * @brief `VK_FORMAT_R8G8B8A8_UNORM`, `VK_FORMAT_B8G8R8A8_UNORM`, `VK_FORMAT_A2B10G10R10_UNORM_PACK32`,
+     *        `VK_FORMAT_R16G16B16A16_UNORM`
+     */
+    VS_FORMAT_SET_COLOR,
+
+    /**
+     * @brief `VK_FORMAT_R8G8B8A8_SRGB`, `VK_FORMAT_B8G8R8A8_SRGB`
+     */
+    VS_FORMAT_SET_COLOR_SRGB,
+
+    /**
+     * @brief `VK_FORMAT_B10G11R11_UFLOAT_PACK32`, `VK_FORMAT_E5B9G9R9_UFLOAT_PACK32`, `VK_FORMAT_R16G16B16A16_SFLOAT`,
+     *        `VK_FORMAT_R32G32B32A32_SFLOAT`
+     */
+    VS_FORMAT_SET_HDR_COLOR,
+
+    /**
+     * @brief `VK_FORMAT_D16_UNORM`, `VK_FORMAT_X8_D24_UNORM_PACK32`, `VK_FORMAT_D32_SFLOAT`
+     */
+    VS_FORMAT_SET_DEPTH,
+
+    /**
+     * @brief `VK_FORMAT_D16_UNORM_S8_UINT`, `VK_FORMAT_D24_UNORM_S8_UINT`, `VK_FORMAT_D32_SFLOAT_S8_UINT`
+     */
+    VS_FORMAT_SET_DEPTH_STENCIL,
+
+    /**
+     * @brief `VK_FORMAT_BC7_UNORM_BLOCK`, `VK_FORMAT_BC3_UNORM_BLOCK`
+     */
+    VS_FORMAT_SET_COMPRESSED_BC,
+
+    /**
+     * @brief `VK_FORMAT_ASTC_4x4_UNORM_BLOCK`
+     */
+    VS_FORMAT_SET_COMPRESSED_ASTC,
+
+    /**
+     * @brief `VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK`
+     */
+    VS_FORMAT_SET_COMPRESSED_ETC2,
+
+    /**
+     * @brief The formats of the three compressed sets, BC first then ASTC then ETC2
+     */
+    VS_FORMAT_SET_COMPRESSED,
+
+    /**
+     * @brief `VK_FORMAT_R16G16B16A16_SFLOAT`, `VK_FORMAT_R32G32B32_SFLOAT`
+     */
+    VS_FORMAT_SET_VERTEX_POSITION,
+
+    /**
+     * @brief `VK_FORMAT_A2B10G10R10_SNORM_PACK32`, `VK_FORMAT_R8G8B8A8_SNORM`, `VK_FORMAT_R16G16B16A16_SNORM`,
+     *        `VK_FORMAT_R32G32B32_SFLOAT`
+     */
+    VS_FORMAT_SET_VERTEX_NORMAL,
+
+    /**
+     * @brief `VK_FORMAT_R16G16_SFLOAT`, `VK_FORMAT_R32G32_SFLOAT`
+     */
+    VS_FORMAT_SET_VERTEX_TEXCOORD,
+
+    VS_FORMAT_SET_COUNT,
+} vs_format_set_kind;
+
+/**
+ * @brief Gets a built-in format set
+ * @note The formats of the set are shared and must not be modified
+ */
+vs_format_set vs_format_set_get(vs_format_set_kind kind);
 
 /**
  * @brief Finds the first format in `candidates` supporting the features in `query`
@@ -348,6 +3033,197 @@ VkFormat vs_format_query_format(VkPhysicalDevice physical_device, vs_format_quer
  */
 void     vs_format_query_formats(VkPhysicalDevice physical_device, vs_format_query query, vs_format_set set, uint32_t *out_count, VkFormat *out_formats);
 
+/*
+ * A `vs_format_table` holds the features of every format of a physical device, queried once, so that format queries
+ * are scans over memory rather than a driver call per candidate.
+ */
+
+/**
+ * @brief The number of formats a `vs_format_table` can hold : the core formats up to Vulkan 1.3, and the formats of
+ *        `VK_IMG_format_pvrtc` and `VK_KHR_maintenance5`
+ */
+#define VS_FORMAT_TABLE_SIZE 248
+
+typedef struct
+{
+    /**
+     * @brief Wether or not the features were queried with `VkFormatProperties3`, otherwise only the 32 first bits are set
+     */
+    bool                  features2;
+
+    /**
+     * @brief The formats available with the version and extensions given to `vs_format_table_build`, in enum order
+     */
+    uint32_t              format_count;
+    VkFormat              formats[VS_FORMAT_TABLE_SIZE];
+    vs_format_features    features[VS_FORMAT_TABLE_SIZE];
+
+    /**
+     * @brief The index + 1 in `formats` of each format the table can hold, 0 if it is not available
+     */
+    uint16_t              slots[VS_FORMAT_TABLE_SIZE];
+} vs_format_table;
+
+/**
+ * @brief Queries the features of every format available on a physical device
+ *
+ * @param physical_device The physical device
+ * @param api_version The version used with the device (the lower of the instance and device versions)
+ * @param extension_count The number of device extensions enabled
+ * @param extensions The enabled device extensions, formats of other extensions are left out
+ * @param[out] out_table Where to write the table
+ * @note `VkFormatProperties3` is used with Vulkan 1.3 or `VK_KHR_format_feature_flags2`
+ */
+void                      vs_format_table_build(VkPhysicalDevice physical_device, uint32_t api_version, uint32_t extension_count, char **extensions, vs_format_table *out_table);
+
+/**
+ * @brief Gets the features of a format, NULL if the format is not in the table
+ */
+const vs_format_features *vs_format_table_get(const vs_format_table *table, VkFormat format);
+
+/**
+ * @brief Finds the first format in `candidates` supporting the features in `query`, without calling Vulkan
+ * @see vs_format_query_index
+ */
+bool                      vs_format_table_query_index(const vs_format_table *table, vs_format_query query, vs_format_set candidates, uint32_t *index);
+
+/**
+ * @brief Finds the first format in `candidates` supporting the features in `query`, without calling Vulkan
+ * @see vs_format_query_format
+ */
+VkFormat                  vs_format_table_query_format(const vs_format_table *table, vs_format_query query, vs_format_set candidates);
+
+/**
+ * @brief Finds the formats in `candidates` supporting the features in `query`, without calling Vulkan
+ * @note If `candidates.formats` is NULL, every format of the table is a candidate
+ * @see vs_format_query_formats
+ */
+void                      vs_format_table_query_formats(const vs_format_table *table, vs_format_query query, vs_format_set candidates, uint32_t *out_count, VkFormat *out_formats);
+
+/**
+ * @brief Answers many queries in a single pass over the candidates
+ *
+ * @param table The table
+ * @param query_count The number of queries
+ * @param queries The queries
+ * @param candidates The formats in which to find suitable ones, in order of preference. If `formats` is NULL, every
+ *        format of the table is a candidate.
+ * @param[out] out_formats Where to write the first suitable format of each query, `VK_FORMAT_UNDEFINED` if none is
+ * @return The number of queries that found a suitable format
+ */
+uint32_t                  vs_format_table_query_batch(const vs_format_table *table, uint32_t query_count, const vs_format_query *queries, vs_format_set candidates, VkFormat *out_formats);
+
+/*
+ * Format features say nothing about the images that can be created with a format : the limits of an image (extent,
+ * sample counts, layers) and whether its usage is supported at all come from `vkGetPhysicalDeviceImageFormatProperties`.
+ * A `vs_image_format_cache` keeps its results per device, so that picking a format for each render target or texture
+ * only calls Vulkan the first time.
+ */
+
+/**
+ * @brief Represents a query for a format usable by an image
+ */
+typedef struct
+{
+    VkImageType              image_type;
+    VkImageTiling            tiling;
+    VkImageUsageFlags        usage;
+    VkImageCreateFlags       flags;
+
+    /**
+     * @brief The features the format must have with `tiling`
+     */
+    VkFormatFeatureFlags2    required_features;
+
+    /**
+     * @brief The sample counts the image must support, `VK_SAMPLE_COUNT_1_BIT` if zero
+     */
+    VkSampleCountFlags       required_samples;
+
+    /**
+     * @brief The smallest extent, mip level count and layer count the image must support, zero is ignored
+     */
+    VkExtent3D               min_extent;
+    uint32_t                 min_mip_levels;
+    uint32_t                 min_array_layers;
+} vs_image_format_query;
+
+#ifndef VS_IMAGE_FORMAT_CACHE_SIZE
+#define VS_IMAGE_FORMAT_CACHE_SIZE 256
+#endif
+
+typedef struct
+{
+    /**
+     * @brief `VK_FORMAT_UNDEFINED` if the entry is empty
+     */
+    VkFormat                   format;
+    VkImageType                image_type;
+    VkImageTiling              tiling;
+    VkImageUsageFlags          usage;
+    VkImageCreateFlags         flags;
+
+    /**
+     * @brief Wether or not the device supports such images, `properties` is only set if it does
+     */
+    bool                       supported;
+    VkImageFormatProperties    properties;
+} vs_image_format_cache_entry;
+
+/**
+ * @brief The image format properties queried on a physical device
+ * @note Not thread safe. Once `VS_IMAGE_FORMAT_CACHE_SIZE` entries are used, new properties are queried every time.
+ */
+typedef struct
+{
+    VkPhysicalDevice               physical_device;
+
+    /**
+     * @brief The format table of the device, checked before calling Vulkan (can be NULL)
+     */
+    const vs_format_table         *table;
+
+    uint32_t                       entry_count;
+    vs_image_format_cache_entry    entries[VS_IMAGE_FORMAT_CACHE_SIZE];
+} vs_image_format_cache;
+
+/**
+ * @brief Initializes an empty cache
+ *
+ * @param[out] cache The cache
+ * @param physical_device The physical device on which to query
+ * @param table The format table of the device, to find the format features without calling Vulkan (can be NULL)
+ */
+void     vs_image_format_cache_init(vs_image_format_cache *cache, VkPhysicalDevice physical_device, const vs_format_table *table);
+
+/**
+ * @brief Gets the image format properties of a format, from the cache or from Vulkan
+ *
+ * @param[out] out_properties Where to write the properties
+ * @return Wether or not such images are supported, `out_properties` is not modified if they are not
+ */
+bool     vs_image_format_cache_get(vs_image_format_cache *cache, VkFormat format, VkImageType image_type, VkImageTiling tiling,
+                                   VkImageUsageFlags usage, VkImageCreateFlags flags, VkImageFormatProperties *out_properties);
+
+/**
+ * @brief Finds the first format in `candidates` with which images fitting `query` can be created
+ *
+ * @param cache The cache of the physical device
+ * @param query The requirements
+ * @param candidates The formats in which to find a suitable one, in order of preference
+ * @param[out] index A pointer to where to write the first suitable format
+ * @return Wether or not a suitable format was found
+ * @note The integer pointed to by `index` will not be modified if the return value is false
+ */
+bool     vs_image_format_query_index(vs_image_format_cache *cache, vs_image_format_query query, vs_format_set candidates, uint32_t *index);
+
+/**
+ * @brief Finds the first format in `candidates` with which images fitting `query` can be created
+ * @return The first suitable format found. `VK_FORMAT_UNDEFINED` if no suitable format was found.
+ * @see vs_image_format_query_index
+ */
+VkFormat vs_image_format_query_format(vs_image_format_cache *cache, vs_image_format_query query, vs_format_set candidates);
+
 // ## SWAPCHAIN
 
 #ifndef VS_SWAPCHAIN_MAX_IMG_COUNT
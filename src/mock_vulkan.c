@@ -0,0 +1,1614 @@
+#include "mock_vulkan.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef struct
+{
+    uint32_t    physical_device_count;
+    vs_mock_physical_device physical_devices[VS_MOCK_MAX_PHYSICAL_DEVICES];
+
+    vs_mock_device_creation last_device_creation;
+
+    vs_mock_submit_stats    submit_stats;
+    uint32_t                submit_cost_ns;
+
+    vs_mock_draw_stats      draw_stats;
+
+    vs_mock_debug_messenger debug_messenger;
+
+    vs_mock_instance_creation last_instance_creation;
+    bool                      legacy_validation_layer;
+
+    vs_mock_memory_stats    memory_stats;
+    uint32_t                allocation_cost_ns;
+
+    vs_mock_command_stats   command_stats;
+    uint32_t                command_buffer_cost_ns;
+
+    // Device commands `vkGetDeviceProcAddr` does not return, as if the driver lacked them
+    uint32_t                hidden_command_count;
+    const char             *hidden_commands[VS_MOCK_MAX_RECORDED_NAMES];
+
+    // Fences are signaled once the serial of their submission is completed
+    uint64_t                submitted_serial;
+    uint64_t                completed_serial;
+    bool                    gpu_paused;
+} _vs_mock_state;
+
+static _vs_mock_state _mock;
+
+// Dispatchable handles start with the slot a Vulkan loader writes its own dispatch table into when the mock is used as
+// an ICD, followed by a pointer to the dispatch table of the driver. The exported hot path commands then behave like the
+// trampolines of the loader : they fetch the table of the handle and call the driver through it, while
+// `vkGetDeviceProcAddr` returns the driver functions directly
+typedef struct
+{
+    PFN_vkQueueSubmit2      QueueSubmit2;
+    PFN_vkGetFenceStatus    GetFenceStatus;
+    PFN_vkCmdDraw           CmdDraw;
+} _vs_mock_dispatch;
+
+typedef struct
+{
+    void                      *loader_data;
+    const _vs_mock_dispatch   *dispatch;
+} _vs_mock_dispatchable;
+
+static const _vs_mock_dispatch _mock_dispatch;
+
+// The value loaders expect in the first slot of the dispatchable handles created by an ICD
+#define _VS_MOCK_ICD_LOADER_MAGIC 0x01CDC0DE
+
+static _vs_mock_dispatchable    _mock_instance = { (void *)(uintptr_t)_VS_MOCK_ICD_LOADER_MAGIC, &_mock_dispatch };
+static _vs_mock_dispatchable    _mock_device = { (void *)(uintptr_t)_VS_MOCK_ICD_LOADER_MAGIC, &_mock_dispatch };
+static _vs_mock_dispatchable    _mock_queues[VS_MOCK_MAX_QUEUE_FAMILIES][64];
+static _vs_mock_dispatchable    _mock_command_buffer = { (void *)(uintptr_t)_VS_MOCK_ICD_LOADER_MAGIC, &_mock_dispatch };
+
+// Other handles only need to be unique and non null
+static int                      _mock_command_pool;
+
+// #############
+// ### SETUP ###
+// #############
+
+void
+vs_mock_reset(void)
+{
+    memset(&_mock, 0, sizeof(_mock));
+}
+
+vs_mock_physical_device *
+vs_mock_add_physical_device(const char *name, VkPhysicalDeviceType type)
+{
+    if(_mock.physical_device_count >= VS_MOCK_MAX_PHYSICAL_DEVICES)
+    {
+        return NULL;
+    }
+
+    vs_mock_physical_device *dev = &_mock.physical_devices[_mock.physical_device_count++];
+    memset(dev, 0, sizeof(*dev));
+    dev->loader_data = (void *)(uintptr_t)_VS_MOCK_ICD_LOADER_MAGIC;
+
+    dev->properties.apiVersion = VK_API_VERSION_1_3;
+    // Required by Vulkan 1.3
+    dev->features_13.synchronization2 = VK_TRUE;
+    dev->properties.deviceType = type;
+    dev->properties.vendorID   = 0x1234;
+    dev->properties.deviceID   = _mock.physical_device_count;
+    snprintf(dev->properties.deviceName, sizeof(dev->properties.deviceName), "%s", name);
+    dev->properties.driverVersion = 1;
+    dev->device_uuid[0]           = (uint8_t)_mock.physical_device_count;
+
+    // Limits of a typical discrete GPU, where buffers and optimal images cannot share a page
+    dev->properties.limits.maxMemoryAllocationCount = 4096;
+    dev->properties.limits.bufferImageGranularity   = 1024;
+    dev->properties.limits.nonCoherentAtomSize      = 64;
+    dev->min_imported_host_pointer_alignment        = 4096;
+
+    // Typical discrete GPU layout : one universal family, one async compute family, one transfer family
+    dev->queue_family_count = 3;
+    dev->queue_families[0]  = (VkQueueFamilyProperties)
+    {
+        .queueFlags         = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT,
+        .queueCount         = 16,
+        .timestampValidBits = 64,
+    };
+    dev->queue_families[1] = (VkQueueFamilyProperties)
+    {
+        .queueFlags         = VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT,
+        .queueCount         = 8,
+        .timestampValidBits = 64,
+    };
+    dev->queue_families[2] = (VkQueueFamilyProperties)
+    {
+        .queueFlags         = VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT,
+        .queueCount         = 2,
+        .timestampValidBits = 64,
+    };
+    dev->present_support[0] = VK_TRUE;
+
+    dev->memory_properties.memoryHeapCount = 2;
+    dev->memory_properties.memoryHeaps[0]  = (VkMemoryHeap){ .size = 8ull << 30, .flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+    dev->memory_properties.memoryHeaps[1]  = (VkMemoryHeap){ .size = 16ull << 30, .flags = 0 };
+    dev->memory_properties.memoryTypeCount = 2;
+    dev->memory_properties.memoryTypes[0]  = (VkMemoryType){ .propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, .heapIndex = 0 };
+    dev->memory_properties.memoryTypes[1]  = (VkMemoryType)
+    {
+        .propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        .heapIndex     = 1
+    };
+
+    return dev;
+}
+
+vs_mock_physical_device *
+vs_mock_physical_device_get(VkPhysicalDevice physical_device)
+{
+    return (vs_mock_physical_device *)physical_device;
+}
+
+const vs_mock_device_creation *
+vs_mock_last_device_creation(void)
+{
+    return &_mock.last_device_creation;
+}
+
+const vs_mock_submit_stats *
+vs_mock_submit_stats_get(void)
+{
+    return &_mock.submit_stats;
+}
+
+const vs_mock_draw_stats *
+vs_mock_draw_stats_get(void)
+{
+    return &_mock.draw_stats;
+}
+
+void
+vs_mock_set_submit_cost(uint32_t nanoseconds)
+{
+    _mock.submit_cost_ns = nanoseconds;
+}
+
+const vs_mock_instance_creation *
+vs_mock_last_instance_creation(void)
+{
+    return &_mock.last_instance_creation;
+}
+
+void
+vs_mock_set_legacy_validation_layer(bool legacy)
+{
+    _mock.legacy_validation_layer = legacy;
+}
+
+const vs_mock_memory_stats *
+vs_mock_memory_stats_get(void)
+{
+    return &_mock.memory_stats;
+}
+
+void
+vs_mock_set_allocation_cost(uint32_t nanoseconds)
+{
+    _mock.allocation_cost_ns = nanoseconds;
+}
+
+const vs_mock_command_stats *
+vs_mock_command_stats_get(void)
+{
+    return &_mock.command_stats;
+}
+
+void
+vs_mock_set_command_buffer_cost(uint32_t nanoseconds)
+{
+    _mock.command_buffer_cost_ns = nanoseconds;
+}
+
+void
+vs_mock_hide_device_command(const char *name)
+{
+    if(_mock.hidden_command_count < VS_MOCK_MAX_RECORDED_NAMES)
+    {
+        _mock.hidden_commands[_mock.hidden_command_count++] = name;
+    }
+}
+
+void
+vs_mock_set_gpu_paused(bool paused)
+{
+    _mock.gpu_paused = paused;
+    if(!paused)
+    {
+        _mock.completed_serial = _mock.submitted_serial;
+    }
+}
+
+const vs_mock_debug_messenger *
+vs_mock_debug_messenger_get(void)
+{
+    return &_mock.debug_messenger;
+}
+
+bool
+vs_mock_emit_debug_message(VkDebugUtilsMessageSeverityFlagBitsEXT severity, int32_t message_id, const char *message)
+{
+    vs_mock_debug_messenger *messenger = &_mock.debug_messenger;
+    if( !messenger->created || !(messenger->severities & severity) )
+    {
+        return false;
+    }
+
+    VkDebugUtilsMessengerCallbackDataEXT data =
+    {
+        .sType           = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CALLBACK_DATA_EXT,
+        .pMessageIdName  = "VUID-mock",
+        .messageIdNumber = message_id,
+        .pMessage        = message,
+    };
+    messenger->callback(severity, VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT, &data, messenger->user_data);
+    return true;
+}
+
+// ################
+// ### INSTANCE ###
+// ################
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateInstanceVersion(uint32_t *pApiVersion)
+{
+    *pApiVersion = VK_API_VERSION_1_3;
+    return VK_SUCCESS;
+}
+
+static const char *_mock_instance_extensions[] =
+{
+    "VK_KHR_surface",
+    "VK_EXT_debug_utils",
+};
+
+// The extensions provided by the validation layer, an older layer only has the first one
+static const char *_mock_validation_layer_extensions[] =
+{
+    "VK_EXT_validation_features",
+    "VK_EXT_layer_settings",
+};
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateInstanceExtensionProperties(const char *pLayerName, uint32_t *pPropertyCount, VkExtensionProperties *pProperties)
+{
+    const char **extensions = _mock_instance_extensions;
+    uint32_t     supported  = sizeof(_mock_instance_extensions) / sizeof(_mock_instance_extensions[0]);
+    if(pLayerName && strcmp(pLayerName, "VK_LAYER_KHRONOS_validation") == 0)
+    {
+        extensions = _mock_validation_layer_extensions;
+        supported  = _mock.legacy_validation_layer ? 1 : 2;
+    }
+    else if(pLayerName)
+    {
+        return VK_ERROR_LAYER_NOT_PRESENT;
+    }
+
+    if(pProperties == NULL)
+    {
+        *pPropertyCount = supported;
+        return VK_SUCCESS;
+    }
+
+    uint32_t count = *pPropertyCount < supported ? *pPropertyCount : supported;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        memset(&pProperties[i], 0, sizeof(VkExtensionProperties));
+        snprintf(pProperties[i].extensionName, sizeof(pProperties[i].extensionName), "%s", extensions[i]);
+        pProperties[i].specVersion = 1;
+    }
+    *pPropertyCount = count;
+    return count < supported ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+static const char *_mock_instance_layers[] =
+{
+    "VK_LAYER_KHRONOS_validation",
+};
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateInstanceLayerProperties(uint32_t *pPropertyCount, VkLayerProperties *pProperties)
+{
+    uint32_t supported = sizeof(_mock_instance_layers) / sizeof(_mock_instance_layers[0]);
+    if(pProperties == NULL)
+    {
+        *pPropertyCount = supported;
+        return VK_SUCCESS;
+    }
+
+    uint32_t count = *pPropertyCount < supported ? *pPropertyCount : supported;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        memset(&pProperties[i], 0, sizeof(VkLayerProperties));
+        snprintf(pProperties[i].layerName, sizeof(pProperties[i].layerName), "%s", _mock_instance_layers[i]);
+        pProperties[i].specVersion = VK_API_VERSION_1_3;
+    }
+    *pPropertyCount = count;
+    return count < supported ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkInstance *pInstance)
+{
+    (void)pAllocator;
+
+    // Record the extensions and the validation layer configuration
+    vs_mock_instance_creation *creation = &_mock.last_instance_creation;
+    memset(creation, 0, sizeof(*creation));
+    creation->enabled_layer_count = pCreateInfo->enabledLayerCount;
+    for(uint32_t i = 0; i < pCreateInfo->enabledExtensionCount && i < VS_MOCK_MAX_RECORDED_NAMES; i++)
+    {
+        snprintf(creation->enabled_extensions[i], VK_MAX_EXTENSION_NAME_SIZE, "%s", pCreateInfo->ppEnabledExtensionNames[i]);
+        creation->enabled_extension_count++;
+    }
+    for(const VkBaseInStructure *next = pCreateInfo->pNext; next; next = next->pNext)
+    {
+        if(next->sType == VK_STRUCTURE_TYPE_LAYER_SETTINGS_CREATE_INFO_EXT)
+        {
+            const VkLayerSettingsCreateInfoEXT *settings = (const VkLayerSettingsCreateInfoEXT *)next;
+            for(uint32_t i = 0; i < settings->settingCount && creation->layer_setting_count < VS_MOCK_MAX_RECORDED_NAMES; i++)
+            {
+                const VkLayerSettingEXT *setting = &settings->pSettings[i];
+                if(setting->type == VK_LAYER_SETTING_TYPE_BOOL32_EXT && setting->valueCount == 1)
+                {
+                    snprintf(creation->layer_settings[creation->layer_setting_count], VK_MAX_EXTENSION_NAME_SIZE, "%s", setting->pSettingName);
+                    creation->layer_setting_values[creation->layer_setting_count++] = *(const VkBool32 *)setting->pValues;
+                }
+            }
+        }
+        else if(next->sType == VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT)
+        {
+            const VkValidationFeaturesEXT *features = (const VkValidationFeaturesEXT *)next;
+            for(uint32_t i = 0; i < features->enabledValidationFeatureCount && i < VS_MOCK_MAX_RECORDED_NAMES; i++)
+            {
+                creation->validation_enables[creation->validation_enable_count++] = features->pEnabledValidationFeatures[i];
+            }
+            for(uint32_t i = 0; i < features->disabledValidationFeatureCount && i < VS_MOCK_MAX_RECORDED_NAMES; i++)
+            {
+                creation->validation_disables[creation->validation_disable_count++] = features->pDisabledValidationFeatures[i];
+            }
+        }
+    }
+
+    *pInstance = (VkInstance)&_mock_instance;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator)
+{
+    (void)instance;
+    (void)pAllocator;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumeratePhysicalDevices(VkInstance instance, uint32_t *pPhysicalDeviceCount, VkPhysicalDevice *pPhysicalDevices)
+{
+    (void)instance;
+    if(pPhysicalDevices == NULL)
+    {
+        *pPhysicalDeviceCount = _mock.physical_device_count;
+        return VK_SUCCESS;
+    }
+
+    uint32_t count = *pPhysicalDeviceCount < _mock.physical_device_count ? *pPhysicalDeviceCount : _mock.physical_device_count;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        pPhysicalDevices[i] = (VkPhysicalDevice)&_mock.physical_devices[i];
+    }
+    *pPhysicalDeviceCount = count;
+    return count < _mock.physical_device_count ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkDebugUtilsMessengerEXT *pMessenger)
+{
+    (void)instance;
+    (void)pAllocator;
+    _mock.debug_messenger = (vs_mock_debug_messenger)
+    {
+        .created    = true,
+        .severities = pCreateInfo->messageSeverity,
+        .types      = pCreateInfo->messageType,
+        .callback   = pCreateInfo->pfnUserCallback,
+        .user_data  = pCreateInfo->pUserData,
+    };
+    *pMessenger = (VkDebugUtilsMessengerEXT)(uintptr_t)0x1u;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT messenger, const VkAllocationCallbacks *pAllocator)
+{
+    (void)instance;
+    (void)messenger;
+    (void)pAllocator;
+    _mock.debug_messenger.created = false;
+}
+
+// #######################
+// ### PHYSICAL DEVICE ###
+// #######################
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties *pProperties)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_properties++;
+    *pProperties = dev->properties;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2 *pProperties)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_properties2++;
+    pProperties->properties = dev->properties;
+
+    for(VkBaseOutStructure *next = pProperties->pNext; next; next = next->pNext)
+    {
+        if(next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES)
+        {
+            VkPhysicalDeviceIDProperties *id = (VkPhysicalDeviceIDProperties *)next;
+            memcpy(id->deviceUUID, dev->device_uuid, VK_UUID_SIZE);
+        }
+        if(next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT)
+        {
+            ( (VkPhysicalDeviceExternalMemoryHostPropertiesEXT *)next )->minImportedHostPointerAlignment = dev->min_imported_host_pointer_alignment;
+        }
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures *pFeatures)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_features++;
+    *pFeatures = dev->features;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceFeatures2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2 *pFeatures)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_features2++;
+    pFeatures->features = dev->features;
+
+    for(VkBaseOutStructure *next = (VkBaseOutStructure *)pFeatures->pNext; next; next = next->pNext)
+    {
+        // Copying a whole structure overwrites its header, which is restored afterwards
+        VkBaseOutStructure header = *next;
+        switch(next->sType)
+        {
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES:
+            *(VkPhysicalDeviceVulkan11Features *)next = dev->features_11;
+            break;
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES:
+            *(VkPhysicalDeviceVulkan12Features *)next = dev->features_12;
+            break;
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES:
+            *(VkPhysicalDeviceVulkan13Features *)next = dev->features_13;
+            break;
+        default:
+            break;
+        }
+        *next = header;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties *pMemoryProperties)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_memory_properties++;
+    *pMemoryProperties = dev->memory_properties;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceMemoryProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties2 *pMemoryProperties)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_memory_properties2++;
+    pMemoryProperties->memoryProperties = dev->memory_properties;
+    for(VkBaseOutStructure *next = pMemoryProperties->pNext; next; next = next->pNext)
+    {
+        if(next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT)
+        {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT *budget = (VkPhysicalDeviceMemoryBudgetPropertiesEXT *)next;
+            for(uint32_t i = 0; i < dev->memory_properties.memoryHeapCount; i++)
+            {
+                budget->heapBudget[i] = dev->heap_budgets[i] ? dev->heap_budgets[i] : dev->memory_properties.memoryHeaps[i].size;
+                budget->heapUsage[i]  = dev->heap_usages[i];
+            }
+        }
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice physicalDevice, uint32_t *pQueueFamilyPropertyCount, VkQueueFamilyProperties *pQueueFamilyProperties)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_queue_family_properties++;
+
+    if(pQueueFamilyProperties == NULL)
+    {
+        *pQueueFamilyPropertyCount = dev->queue_family_count;
+        return;
+    }
+
+    uint32_t count = *pQueueFamilyPropertyCount < dev->queue_family_count ? *pQueueFamilyPropertyCount : dev->queue_family_count;
+    memcpy(pQueueFamilyProperties, dev->queue_families, sizeof(VkQueueFamilyProperties) * count);
+    *pQueueFamilyPropertyCount = count;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateDeviceExtensionProperties(VkPhysicalDevice physicalDevice, const char *pLayerName, uint32_t *pPropertyCount, VkExtensionProperties *pProperties)
+{
+    (void)pLayerName;
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.enumerate_extensions++;
+
+    if(pProperties == NULL)
+    {
+        *pPropertyCount = dev->extension_count;
+        return VK_SUCCESS;
+    }
+
+    uint32_t count = *pPropertyCount < dev->extension_count ? *pPropertyCount : dev->extension_count;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        memset(&pProperties[i], 0, sizeof(VkExtensionProperties));
+        snprintf(pProperties[i].extensionName, sizeof(pProperties[i].extensionName), "%s", dev->extensions[i]);
+        pProperties[i].specVersion = 1;
+    }
+    *pPropertyCount = count;
+    return count < dev->extension_count ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkGetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, VkSurfaceKHR surface, VkBool32 *pSupported)
+{
+    (void)surface;
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_surface_support++;
+    *pSupported = queueFamilyIndex < dev->queue_family_count ? dev->present_support[queueFamilyIndex] : VK_FALSE;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkSurfaceCapabilitiesKHR *pSurfaceCapabilities)
+{
+    (void)physicalDevice;
+    (void)surface;
+    memset(pSurfaceCapabilities, 0, sizeof(*pSurfaceCapabilities));
+    pSurfaceCapabilities->minImageCount = 2;
+    pSurfaceCapabilities->maxImageCount = 8;
+    return VK_SUCCESS;
+}
+
+// Everything is supported, except for block compressed formats which can only be sampled. The 64-bit flags add the
+// storage without format and depth comparison features to the formats with every feature.
+static void
+_vs_mock_format_features(VkFormat format, VkFormatFeatureFlags2 *linear, VkFormatFeatureFlags2 *optimal, VkFormatFeatureFlags2 *buffer)
+{
+    *linear  = 0;
+    *optimal = 0;
+    *buffer  = 0;
+    if(format == VK_FORMAT_UNDEFINED)
+    {
+        return;
+    }
+    *optimal = ~0u | VK_FORMAT_FEATURE_2_STORAGE_WRITE_WITHOUT_FORMAT_BIT | VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_DEPTH_COMPARISON_BIT;
+    *linear  = ~0u;
+    *buffer  = ~0u;
+    if(format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+    {
+        *optimal = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+        *linear  = 0;
+        *buffer  = 0;
+    }
+    else if(format >= VK_FORMAT_D16_UNORM && format <= VK_FORMAT_D32_SFLOAT_S8_UINT)
+    {
+        // Depth and stencil formats are only attachments and sampled images
+        *optimal &= ~(VkFormatFeatureFlags2)(VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+        *linear  = 0;
+        *buffer  = 0;
+    }
+    else
+    {
+        *optimal &= ~(VkFormatFeatureFlags2)VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        *linear  &= ~(VkFormatFeatureFlags2)VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format, VkFormatProperties *pFormatProperties)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_format_properties++;
+
+    VkFormatFeatureFlags2 linear, optimal, buffer;
+    _vs_mock_format_features(format, &linear, &optimal, &buffer);
+    pFormatProperties->linearTilingFeatures  = (VkFormatFeatureFlags)linear;
+    pFormatProperties->optimalTilingFeatures = (VkFormatFeatureFlags)optimal;
+    pFormatProperties->bufferFeatures        = (VkFormatFeatureFlags)buffer;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceFormatProperties2(VkPhysicalDevice physicalDevice, VkFormat format, VkFormatProperties2 *pFormatProperties)
+{
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_format_properties2++;
+
+    VkFormatFeatureFlags2 linear, optimal, buffer;
+    _vs_mock_format_features(format, &linear, &optimal, &buffer);
+    pFormatProperties->formatProperties.linearTilingFeatures  = (VkFormatFeatureFlags)linear;
+    pFormatProperties->formatProperties.optimalTilingFeatures = (VkFormatFeatureFlags)optimal;
+    pFormatProperties->formatProperties.bufferFeatures        = (VkFormatFeatureFlags)buffer;
+    for(VkBaseOutStructure *next = pFormatProperties->pNext; next; next = next->pNext)
+    {
+        if(next->sType == VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3)
+        {
+            VkFormatProperties3 *props3   = (VkFormatProperties3 *)next;
+            props3->linearTilingFeatures  = linear;
+            props3->optimalTilingFeatures = optimal;
+            props3->bufferFeatures        = buffer;
+        }
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkGetPhysicalDeviceImageFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format, VkImageType type, VkImageTiling tiling,
+                                         VkImageUsageFlags usage, VkImageCreateFlags flags, VkImageFormatProperties *pImageFormatProperties)
+{
+    (void)flags;
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+    dev->calls.get_image_format_properties++;
+    memset(pImageFormatProperties, 0, sizeof(VkImageFormatProperties) );
+
+    // Every usage needs the matching format feature, like the specification requires
+    VkFormatFeatureFlags2 linear, optimal, buffer;
+    _vs_mock_format_features(format, &linear, &optimal, &buffer);
+    VkFormatFeatureFlags2 features = tiling == VK_IMAGE_TILING_LINEAR ? linear : optimal;
+    VkFormatFeatureFlags2 required = 0;
+    required |= (usage & VK_IMAGE_USAGE_SAMPLED_BIT) ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0;
+    required |= (usage & VK_IMAGE_USAGE_STORAGE_BIT) ? VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT : 0;
+    required |= (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) ? VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT : 0;
+    required |= (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) ? VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT : 0;
+    required |= (usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) ? VK_FORMAT_FEATURE_TRANSFER_SRC_BIT : 0;
+    required |= (usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ? VK_FORMAT_FEATURE_TRANSFER_DST_BIT : 0;
+    bool depth = format >= VK_FORMAT_D16_UNORM && format <= VK_FORMAT_D32_SFLOAT_S8_UINT;
+    if(features == 0 || (features & required) != required || (depth && type == VK_IMAGE_TYPE_3D) )
+    {
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    if(dev->image_format_override == format)
+    {
+        *pImageFormatProperties = dev->image_format_override_properties;
+        return VK_SUCCESS;
+    }
+
+    uint32_t size = type == VK_IMAGE_TYPE_3D ? 2048 : 16384;
+    pImageFormatProperties->maxExtent.width  = size;
+    pImageFormatProperties->maxExtent.height = type == VK_IMAGE_TYPE_1D ? 1 : size;
+    pImageFormatProperties->maxExtent.depth  = type == VK_IMAGE_TYPE_3D ? size : 1;
+    pImageFormatProperties->maxMipLevels     = type == VK_IMAGE_TYPE_3D ? 12 : 15;
+    pImageFormatProperties->maxArrayLayers   = type == VK_IMAGE_TYPE_3D ? 1 : 2048;
+    pImageFormatProperties->sampleCounts     = VK_SAMPLE_COUNT_1_BIT;
+    pImageFormatProperties->maxResourceSize  = (VkDeviceSize)1 << 31;
+    if( tiling == VK_IMAGE_TILING_OPTIMAL && type == VK_IMAGE_TYPE_2D &&
+        (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) ) )
+    {
+        pImageFormatProperties->sampleCounts |= VK_SAMPLE_COUNT_2_BIT | VK_SAMPLE_COUNT_4_BIT | VK_SAMPLE_COUNT_8_BIT;
+    }
+    return VK_SUCCESS;
+}
+
+// ##############
+// ### DEVICE ###
+// ##############
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkDevice *pDevice)
+{
+    (void)pAllocator;
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(physicalDevice);
+
+    // Validate the queue create infos like a driver would
+    for(uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++)
+    {
+        const VkDeviceQueueCreateInfo *ci = &pCreateInfo->pQueueCreateInfos[i];
+        if(ci->queueFamilyIndex >= dev->queue_family_count || ci->queueCount > dev->queue_families[ci->queueFamilyIndex].queueCount)
+        {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        for(uint32_t j = 0; j < i; j++)
+        {
+            if(pCreateInfo->pQueueCreateInfos[j].queueFamilyIndex == ci->queueFamilyIndex)
+            {
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+        }
+        for(uint32_t j = 0; j < ci->queueCount; j++)
+        {
+            if( !(ci->pQueuePriorities[j] >= 0.0f && ci->pQueuePriorities[j] <= 1.0f) )
+            {
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+        }
+    }
+
+    // Elevated global priorities are refused like an unprivileged process would be
+    VkQueueGlobalPriorityKHR global_priorities[VS_MOCK_MAX_QUEUE_FAMILIES] = { 0 };
+    VkQueueGlobalPriorityKHR max_global_priority = dev->max_global_priority ? dev->max_global_priority : VK_QUEUE_GLOBAL_PRIORITY_MEDIUM_KHR;
+    for(uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++)
+    {
+        for(const VkBaseInStructure *next = pCreateInfo->pQueueCreateInfos[i].pNext; next; next = next->pNext)
+        {
+            if(next->sType == VK_STRUCTURE_TYPE_DEVICE_QUEUE_GLOBAL_PRIORITY_CREATE_INFO_KHR)
+            {
+                global_priorities[i] = ( (const VkDeviceQueueGlobalPriorityCreateInfoKHR *)next )->globalPriority;
+            }
+        }
+        if(global_priorities[i] > max_global_priority)
+        {
+            _mock.last_device_creation.refused_global_priority_count++;
+            return VK_ERROR_NOT_PERMITTED_KHR;
+        }
+    }
+
+    // Gather the enabled features, pEnabledFeatures and VkPhysicalDeviceFeatures2 are mutually exclusive
+    vs_mock_device_creation features = { 0 };
+    if(pCreateInfo->pEnabledFeatures)
+    {
+        features.features = *pCreateInfo->pEnabledFeatures;
+    }
+    for(const VkBaseInStructure *next = pCreateInfo->pNext; next; next = next->pNext)
+    {
+        switch(next->sType)
+        {
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2:
+            if(pCreateInfo->pEnabledFeatures)
+            {
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+            features.features = ( (const VkPhysicalDeviceFeatures2 *)next )->features;
+            break;
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES:
+            features.features_11 = *(const VkPhysicalDeviceVulkan11Features *)next;
+            break;
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES:
+            features.features_12 = *(const VkPhysicalDeviceVulkan12Features *)next;
+            break;
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES:
+            features.features_13 = *(const VkPhysicalDeviceVulkan13Features *)next;
+            break;
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR:
+            features.synchronization2 = ( (const VkPhysicalDeviceSynchronization2FeaturesKHR *)next )->synchronization2;
+            if(features.synchronization2 && !dev->features_13.synchronization2)
+            {
+                return VK_ERROR_FEATURE_NOT_PRESENT;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Every feature structure is a header followed by VkBool32 members
+    struct
+    {
+        const void    *enabled;
+        const void    *supported;
+        size_t         header;
+        size_t         size;
+    } feature_structs[] =
+    {
+        { &features.features, &dev->features, 0, sizeof(VkPhysicalDeviceFeatures) },
+        { &features.features_11, &dev->features_11, offsetof(VkPhysicalDeviceVulkan11Features, storageBuffer16BitAccess), offsetof(VkPhysicalDeviceVulkan11Features, shaderDrawParameters) + sizeof(VkBool32) },
+        { &features.features_12, &dev->features_12, offsetof(VkPhysicalDeviceVulkan12Features, samplerMirrorClampToEdge), offsetof(VkPhysicalDeviceVulkan12Features, subgroupBroadcastDynamicId) + sizeof(VkBool32) },
+        { &features.features_13, &dev->features_13, offsetof(VkPhysicalDeviceVulkan13Features, robustImageAccess), offsetof(VkPhysicalDeviceVulkan13Features, maintenance4) + sizeof(VkBool32) },
+    };
+    for(uint32_t i = 0; i < sizeof(feature_structs) / sizeof(feature_structs[0]); i++)
+    {
+        const VkBool32 *enabled   = (const VkBool32 *)( (const char *)feature_structs[i].enabled + feature_structs[i].header );
+        const VkBool32 *supported = (const VkBool32 *)( (const char *)feature_structs[i].supported + feature_structs[i].header );
+        for(size_t j = 0; j < (feature_structs[i].size - feature_structs[i].header) / sizeof(VkBool32); j++)
+        {
+            if(enabled[j] && !supported[j])
+            {
+                return VK_ERROR_FEATURE_NOT_PRESENT;
+            }
+        }
+    }
+
+    vs_mock_device_creation *rec = &_mock.last_device_creation;
+    features.refused_global_priority_count = rec->refused_global_priority_count;
+    *rec = features;
+    memcpy(rec->global_priorities, global_priorities, sizeof(global_priorities) );
+    for(uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++)
+    {
+        const VkDeviceQueueCreateInfo *ci = &pCreateInfo->pQueueCreateInfos[i];
+        memcpy(rec->queue_priorities[i], ci->pQueuePriorities, sizeof(float) * (ci->queueCount < 64 ? ci->queueCount : 64) );
+    }
+    rec->physical_device         = physicalDevice;
+    rec->queue_create_info_count = pCreateInfo->queueCreateInfoCount;
+    rec->enabled_extension_count = pCreateInfo->enabledExtensionCount;
+    memcpy(rec->queue_create_infos, pCreateInfo->pQueueCreateInfos, sizeof(VkDeviceQueueCreateInfo) * pCreateInfo->queueCreateInfoCount);
+
+    *pDevice = (VkDevice)&_mock_device;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator)
+{
+    (void)device;
+    (void)pAllocator;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue *pQueue)
+{
+    (void)device;
+    _vs_mock_dispatchable *queue = &_mock_queues[queueFamilyIndex % VS_MOCK_MAX_QUEUE_FAMILIES][queueIndex % 64];
+    if(queue->loader_data == NULL)
+    {
+        queue->loader_data = (void *)(uintptr_t)_VS_MOCK_ICD_LOADER_MAGIC;
+    }
+    queue->dispatch = &_mock_dispatch;
+    *pQueue         = (VkQueue)queue;
+}
+
+// #############
+// ### QUEUE ###
+// #############
+
+static uint64_t
+_vs_mock_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// A timeline semaphore, and the value the last submission signaling it sets once completed
+typedef struct
+{
+    uint64_t    value;
+    uint64_t    pending_value;
+    uint64_t    pending_serial;
+} _vs_mock_semaphore;
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+_vs_mock_vkQueueSubmit2(VkQueue queue, uint32_t submitCount, const VkSubmitInfo2 *pSubmits, VkFence fence)
+{
+    (void)queue;
+
+    // Queues are externally synchronized, so the counters do not need to be atomic
+    _mock.submit_stats.submit_calls++;
+    _mock.submit_stats.submit_infos        += submitCount;
+    _mock.submit_stats.fenced_submit_calls += fence != VK_NULL_HANDLE;
+
+    _mock.submitted_serial++;
+    if(!_mock.gpu_paused)
+    {
+        _mock.completed_serial = _mock.submitted_serial;
+    }
+    for(uint32_t i = 0; i < submitCount; i++)
+    {
+        for(uint32_t j = 0; j < pSubmits[i].signalSemaphoreInfoCount; j++)
+        {
+            _vs_mock_semaphore *semaphore = (_vs_mock_semaphore *)(uintptr_t)pSubmits[i].pSignalSemaphoreInfos[j].semaphore;
+
+            // A signal that completed is not lost when the next one is pending
+            if(semaphore->pending_serial != 0 && semaphore->pending_serial <= _mock.completed_serial)
+            {
+                semaphore->value = semaphore->pending_value;
+            }
+            semaphore->pending_value  = pSubmits[i].pSignalSemaphoreInfos[j].value;
+            semaphore->pending_serial = _mock.submitted_serial;
+        }
+    }
+    if(fence != VK_NULL_HANDLE)
+    {
+        *(uint64_t *)(uintptr_t)fence = _mock.submitted_serial;
+    }
+
+    if(_mock.submit_cost_ns)
+    {
+        uint64_t end = _vs_mock_now_ns() + _mock.submit_cost_ns;
+        while(_vs_mock_now_ns() < end)
+        {
+        }
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits, VkFence fence)
+{
+    (void)queue;
+    (void)pSubmits;
+    _mock.submit_stats.submit_calls++;
+    _mock.submit_stats.submit_infos        += submitCount;
+    _mock.submit_stats.fenced_submit_calls += fence != VK_NULL_HANDLE;
+
+    _mock.submitted_serial++;
+    if(!_mock.gpu_paused)
+    {
+        _mock.completed_serial = _mock.submitted_serial;
+    }
+    if(fence != VK_NULL_HANDLE)
+    {
+        *(uint64_t *)(uintptr_t)fence = _mock.submitted_serial;
+    }
+    return VK_SUCCESS;
+}
+
+// ##############
+// ### FENCES ###
+// ##############
+
+// A fence holds the serial of the submission that signals it, zero if unsignaled
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateFence(VkDevice device, const VkFenceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkFence *pFence)
+{
+    (void)device;
+    (void)pAllocator;
+    uint64_t *serial = calloc(1, sizeof(uint64_t) );
+    if(pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT)
+    {
+        *serial = _mock.completed_serial ? _mock.completed_serial : (_mock.completed_serial = _mock.submitted_serial = 1);
+    }
+    *pFence = (VkFence)(uintptr_t)serial;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyFence(VkDevice device, VkFence fence, const VkAllocationCallbacks *pAllocator)
+{
+    (void)device;
+    (void)pAllocator;
+    free( (void *)(uintptr_t)fence );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkResetFences(VkDevice device, uint32_t fenceCount, const VkFence *pFences)
+{
+    (void)device;
+    for(uint32_t i = 0; i < fenceCount; i++)
+    {
+        *(uint64_t *)(uintptr_t)pFences[i] = 0;
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkWaitForFences(VkDevice device, uint32_t fenceCount, const VkFence *pFences, VkBool32 waitAll, uint64_t timeout)
+{
+    (void)device;
+    (void)waitAll;
+    (void)timeout;
+
+    // Waiting completes the submissions, even if the GPU is paused
+    for(uint32_t i = 0; i < fenceCount; i++)
+    {
+        uint64_t serial = *(uint64_t *)(uintptr_t)pFences[i];
+        if(serial == 0)
+        {
+            return VK_TIMEOUT;
+        }
+        _mock.completed_serial = serial > _mock.completed_serial ? serial : _mock.completed_serial;
+    }
+    return VK_SUCCESS;
+}
+
+// ##################
+// ### SEMAPHORES ###
+// ##################
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore)
+{
+    (void)device;
+    (void)pAllocator;
+    _vs_mock_semaphore *semaphore = calloc(1, sizeof(_vs_mock_semaphore) );
+    for(const VkBaseInStructure *next = pCreateInfo->pNext; next; next = next->pNext)
+    {
+        if(next->sType == VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO)
+        {
+            semaphore->value = ( (const VkSemaphoreTypeCreateInfo *)next )->initialValue;
+        }
+    }
+    *pSemaphore = (VkSemaphore)(uintptr_t)semaphore;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroySemaphore(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks *pAllocator)
+{
+    (void)device;
+    (void)pAllocator;
+    free( (void *)(uintptr_t)semaphore );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkGetSemaphoreCounterValue(VkDevice device, VkSemaphore semaphore, uint64_t *pValue)
+{
+    (void)device;
+    _vs_mock_semaphore *sem = (_vs_mock_semaphore *)(uintptr_t)semaphore;
+    if(sem->pending_serial != 0 && sem->pending_serial <= _mock.completed_serial)
+    {
+        sem->value          = sem->pending_value;
+        sem->pending_serial = 0;
+    }
+    *pValue = sem->value;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkWaitSemaphores(VkDevice device, const VkSemaphoreWaitInfo *pWaitInfo, uint64_t timeout)
+{
+    (void)timeout;
+
+    // Waiting completes every submission, even if the GPU is paused
+    _mock.completed_serial = _mock.submitted_serial;
+    for(uint32_t i = 0; i < pWaitInfo->semaphoreCount; i++)
+    {
+        uint64_t value;
+        vkGetSemaphoreCounterValue(device, pWaitInfo->pSemaphores[i], &value);
+        if(value < pWaitInfo->pValues[i])
+        {
+            return VK_TIMEOUT;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+// #######################
+// ### COMMAND BUFFERS ###
+// #######################
+
+static void
+_vs_mock_command_buffer_cost(void)
+{
+    if(_mock.command_buffer_cost_ns)
+    {
+        uint64_t end = _vs_mock_now_ns() + _mock.command_buffer_cost_ns;
+        while(_vs_mock_now_ns() < end)
+        {
+        }
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+{
+    (void)device;
+    (void)pCreateInfo;
+    (void)pAllocator;
+    atomic_fetch_add(&_mock.command_stats.created_pools, 1);
+    *pCommandPool = (VkCommandPool)(uintptr_t)&_mock_command_pool;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks *pAllocator)
+{
+    (void)device;
+    (void)pAllocator;
+    if(commandPool != VK_NULL_HANDLE)
+    {
+        atomic_fetch_add(&_mock.command_stats.destroyed_pools, 1);
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo, VkCommandBuffer *pCommandBuffers)
+{
+    (void)device;
+    for(uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++)
+    {
+        pCommandBuffers[i] = (VkCommandBuffer)&_mock_command_buffer;
+    }
+    atomic_fetch_add(&_mock.command_stats.allocate_calls, 1);
+    atomic_fetch_add(&_mock.command_stats.allocated_buffers, pAllocateInfo->commandBufferCount);
+    _vs_mock_command_buffer_cost();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkFreeCommandBuffers(VkDevice device, VkCommandPool commandPool, uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers)
+{
+    (void)device;
+    (void)commandPool;
+    (void)pCommandBuffers;
+    atomic_fetch_add(&_mock.command_stats.freed_buffers, commandBufferCount);
+    _vs_mock_command_buffer_cost();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkResetCommandPool(VkDevice device, VkCommandPool commandPool, VkCommandPoolResetFlags flags)
+{
+    (void)device;
+    (void)commandPool;
+    (void)flags;
+    atomic_fetch_add(&_mock.command_stats.pool_resets, 1);
+    _vs_mock_command_buffer_cost();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkBeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo *pBeginInfo)
+{
+    (void)commandBuffer;
+    (void)pBeginInfo;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    (void)commandBuffer;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo *pDependencyInfo)
+{
+    (void)commandBuffer;
+    _mock.memory_stats.buffer_barriers += pDependencyInfo->bufferMemoryBarrierCount;
+    _mock.memory_stats.image_barriers  += pDependencyInfo->imageMemoryBarrierCount;
+    for(uint32_t i = 0; i < pDependencyInfo->bufferMemoryBarrierCount; i++)
+    {
+        const VkBufferMemoryBarrier2 *barrier = &pDependencyInfo->pBufferMemoryBarriers[i];
+        _mock.memory_stats.ownership_transfers += barrier->srcQueueFamilyIndex != barrier->dstQueueFamilyIndex;
+    }
+    for(uint32_t i = 0; i < pDependencyInfo->imageMemoryBarrierCount; i++)
+    {
+        const VkImageMemoryBarrier2 *barrier = &pDependencyInfo->pImageMemoryBarriers[i];
+        _mock.memory_stats.ownership_transfers += barrier->srcQueueFamilyIndex != barrier->dstQueueFamilyIndex;
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+_vs_mock_vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+    (void)commandBuffer;
+    (void)firstVertex;
+    (void)firstInstance;
+    _mock.draw_stats.draw_calls++;
+    _mock.draw_stats.vertices += (uint64_t)vertexCount * instanceCount;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+_vs_mock_vkGetFenceStatus(VkDevice device, VkFence fence)
+{
+    (void)device;
+    if(fence == VK_NULL_HANDLE)
+    {
+        return VK_SUCCESS;
+    }
+    uint64_t serial = *(uint64_t *)(uintptr_t)fence;
+    return serial != 0 && serial <= _mock.completed_serial ? VK_SUCCESS : VK_NOT_READY;
+}
+
+// ##############
+// ### MEMORY ###
+// ##############
+
+typedef struct
+{
+    VkDeviceSize    size;
+    uint32_t        type_index;
+    bool            dedicated;
+    void           *host;
+
+    // The host memory is the imported pointer, which the mock does not own
+    bool            imported;
+} _vs_mock_memory;
+
+static void *
+_vs_mock_memory_host(_vs_mock_memory *memory)
+{
+    if(memory->host == NULL)
+    {
+        // Page aligned like the mappings of drivers, which O_DIRECT reads rely on
+        memory->host = aligned_alloc(4096, (memory->size + 4095) & ~(VkDeviceSize)4095);
+    }
+    return memory->host;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo, const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory)
+{
+    (void)device;
+    (void)pAllocator;
+
+    // The limit of the device last created, as drivers refuse allocations past `maxMemoryAllocationCount`
+    VkPhysicalDevice physical_device = _mock.last_device_creation.physical_device;
+    uint32_t         max_count       = physical_device ? vs_mock_physical_device_get(physical_device)->properties.limits.maxMemoryAllocationCount : 4096;
+    if(_mock.memory_stats.live_allocations >= max_count)
+    {
+        return VK_ERROR_TOO_MANY_OBJECTS;
+    }
+
+    _vs_mock_memory *memory = calloc(1, sizeof(_vs_mock_memory) );
+    memory->size       = pAllocateInfo->allocationSize;
+    memory->type_index = pAllocateInfo->memoryTypeIndex;
+    for(const VkBaseInStructure *next = pAllocateInfo->pNext; next; next = next->pNext)
+    {
+        memory->dedicated |= next->sType == VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        if(next->sType == VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT)
+        {
+            // The pointer and the size must both be aligned to `minImportedHostPointerAlignment`
+            const VkImportMemoryHostPointerInfoEXT *import    = (const VkImportMemoryHostPointerInfoEXT *)next;
+            VkDeviceSize                            alignment = vs_mock_physical_device_get(physical_device)->min_imported_host_pointer_alignment;
+            if( (uintptr_t)import->pHostPointer % alignment != 0 || memory->size % alignment != 0 )
+            {
+                free(memory);
+                return VK_ERROR_INVALID_EXTERNAL_HANDLE;
+            }
+            memory->host     = import->pHostPointer;
+            memory->imported = true;
+            _mock.memory_stats.imported_allocations++;
+        }
+    }
+
+    _mock.memory_stats.allocate_calls++;
+    _mock.memory_stats.live_allocations++;
+    _mock.memory_stats.live_bytes            += memory->size;
+    _mock.memory_stats.dedicated_allocations += memory->dedicated;
+
+    // Stands for the kernel round trip of a real driver
+    if(_mock.allocation_cost_ns)
+    {
+        uint64_t end = _vs_mock_now_ns() + _mock.allocation_cost_ns;
+        while(_vs_mock_now_ns() < end)
+        {
+        }
+    }
+
+    *pMemory = (VkDeviceMemory)(uintptr_t)memory;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *pAllocator)
+{
+    (void)device;
+    (void)pAllocator;
+    _vs_mock_memory *mem = (_vs_mock_memory *)(uintptr_t)memory;
+    if(mem == NULL)
+    {
+        return;
+    }
+
+    _mock.memory_stats.free_calls++;
+    _mock.memory_stats.live_allocations--;
+    _mock.memory_stats.live_bytes            -= mem->size;
+    _mock.memory_stats.dedicated_allocations -= mem->dedicated;
+    if(!mem->imported)
+    {
+        free(mem->host);
+    }
+    free(mem);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags, void **ppData)
+{
+    (void)device;
+    (void)size;
+    (void)flags;
+    _vs_mock_memory *mem = (_vs_mock_memory *)(uintptr_t)memory;
+
+    // Backed lazily, pages are only committed once written
+    _mock.memory_stats.map_calls++;
+    *ppData = (char *)_vs_mock_memory_host(mem) + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkUnmapMemory(VkDevice device, VkDeviceMemory memory)
+{
+    (void)device;
+    (void)memory;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkGetMemoryHostPointerPropertiesEXT(VkDevice device, VkExternalMemoryHandleTypeFlagBits handleType, const void *pHostPointer, VkMemoryHostPointerPropertiesEXT *pMemoryHostPointerProperties)
+{
+    (void)device;
+    vs_mock_physical_device *dev = vs_mock_physical_device_get(_mock.last_device_creation.physical_device);
+    if(handleType != VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT || (uintptr_t)pHostPointer % dev->min_imported_host_pointer_alignment != 0)
+    {
+        return VK_ERROR_INVALID_EXTERNAL_HANDLE;
+    }
+
+    // Host memory can be imported in every host visible type
+    pMemoryHostPointerProperties->memoryTypeBits = 0;
+    for(uint32_t i = 0; i < dev->memory_properties.memoryTypeCount; i++)
+    {
+        if(dev->memory_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            pMemoryHostPointerProperties->memoryTypeBits |= 1u << i;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+// A buffer is only the range of memory it is bound to
+typedef struct
+{
+    VkDeviceSize        size;
+    _vs_mock_memory    *memory;
+    VkDeviceSize        offset;
+} _vs_mock_buffer;
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateBuffer(VkDevice device, const VkBufferCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkBuffer *pBuffer)
+{
+    (void)device;
+    (void)pAllocator;
+    _vs_mock_buffer *buffer = calloc(1, sizeof(_vs_mock_buffer) );
+    buffer->size = pCreateInfo->size;
+    *pBuffer     = (VkBuffer)(uintptr_t)buffer;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks *pAllocator)
+{
+    (void)device;
+    (void)pAllocator;
+    free( (void *)(uintptr_t)buffer );
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetBufferMemoryRequirements(VkDevice device, VkBuffer buffer, VkMemoryRequirements *pMemoryRequirements)
+{
+    (void)device;
+    _vs_mock_buffer *buf = (_vs_mock_buffer *)(uintptr_t)buffer;
+    *pMemoryRequirements = (VkMemoryRequirements)
+    {
+        .size           = (buf->size + 255) & ~255ull,
+        .alignment      = 256,
+        .memoryTypeBits = ~0u,
+    };
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+{
+    (void)device;
+    _vs_mock_buffer *buf = (_vs_mock_buffer *)(uintptr_t)buffer;
+    buf->memory = (_vs_mock_memory *)(uintptr_t)memory;
+    buf->offset = memoryOffset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy *pRegions)
+{
+    (void)commandBuffer;
+    _vs_mock_buffer *src = (_vs_mock_buffer *)(uintptr_t)srcBuffer;
+    _vs_mock_buffer *dst = (_vs_mock_buffer *)(uintptr_t)dstBuffer;
+    char            *src_host = (char *)_vs_mock_memory_host(src->memory) + src->offset;
+    char            *dst_host = (char *)_vs_mock_memory_host(dst->memory) + dst->offset;
+    for(uint32_t i = 0; i < regionCount; i++)
+    {
+        memmove(dst_host + pRegions[i].dstOffset, src_host + pRegions[i].srcOffset, pRegions[i].size);
+        _mock.memory_stats.copy_regions++;
+        _mock.memory_stats.copied_bytes += pRegions[i].size;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount, const VkBufferImageCopy *pRegions)
+{
+    (void)commandBuffer;
+    (void)srcBuffer;
+    (void)dstImage;
+    (void)dstImageLayout;
+    _mock.memory_stats.image_copy_regions += regionCount;
+    if(regionCount)
+    {
+        _mock.memory_stats.image_copy_offset = pRegions[regionCount - 1].bufferOffset;
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkFlushMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange *pMemoryRanges)
+{
+    (void)device;
+    (void)pMemoryRanges;
+    _mock.memory_stats.flushed_ranges += memoryRangeCount;
+    return VK_SUCCESS;
+}
+
+// ###################
+// ### TRAMPOLINES ###
+// ###################
+
+static const _vs_mock_dispatch _mock_dispatch =
+{
+    .QueueSubmit2   = _vs_mock_vkQueueSubmit2,
+    .GetFenceStatus = _vs_mock_vkGetFenceStatus,
+    .CmdDraw        = _vs_mock_vkCmdDraw,
+};
+
+static inline const _vs_mock_dispatch *
+_vs_mock_dispatch_of(const void *handle)
+{
+    return ( (const _vs_mock_dispatchable *)handle )->dispatch;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkQueueSubmit2(VkQueue queue, uint32_t submitCount, const VkSubmitInfo2 *pSubmits, VkFence fence)
+{
+    return _vs_mock_dispatch_of(queue)->QueueSubmit2(queue, submitCount, pSubmits, fence);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkGetFenceStatus(VkDevice device, VkFence fence)
+{
+    return _vs_mock_dispatch_of(device)->GetFenceStatus(device, fence);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+    _vs_mock_dispatch_of(commandBuffer)->CmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+// ####################
+// ### PROC ADDRESS ###
+// ####################
+
+typedef struct
+{
+    const char           *name;
+    PFN_vkVoidFunction    func;
+} _vs_mock_entry_point;
+
+#define _VS_MOCK_ENTRY(name) { #name, (PFN_vkVoidFunction)name }
+
+static const _vs_mock_entry_point _mock_entry_points[] =
+{
+    _VS_MOCK_ENTRY(vkEnumerateInstanceVersion),
+    _VS_MOCK_ENTRY(vkEnumerateInstanceExtensionProperties),
+    _VS_MOCK_ENTRY(vkEnumerateInstanceLayerProperties),
+    _VS_MOCK_ENTRY(vkCreateInstance),
+    _VS_MOCK_ENTRY(vkDestroyInstance),
+    _VS_MOCK_ENTRY(vkEnumeratePhysicalDevices),
+    _VS_MOCK_ENTRY(vkCreateDebugUtilsMessengerEXT),
+    _VS_MOCK_ENTRY(vkDestroyDebugUtilsMessengerEXT),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceProperties),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceProperties2),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceFeatures),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceFeatures2),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceMemoryProperties),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceMemoryProperties2),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceQueueFamilyProperties),
+    _VS_MOCK_ENTRY(vkEnumerateDeviceExtensionProperties),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceSurfaceSupportKHR),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceSurfaceCapabilitiesKHR),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceFormatProperties),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceFormatProperties2),
+    _VS_MOCK_ENTRY(vkGetPhysicalDeviceImageFormatProperties),
+    _VS_MOCK_ENTRY(vkCreateDevice),
+    _VS_MOCK_ENTRY(vkDestroyDevice),
+    _VS_MOCK_ENTRY(vkGetDeviceProcAddr),
+    _VS_MOCK_ENTRY(vkGetDeviceQueue),
+    _VS_MOCK_ENTRY(vkQueueSubmit2),
+    _VS_MOCK_ENTRY(vkGetFenceStatus),
+    _VS_MOCK_ENTRY(vkCreateCommandPool),
+    _VS_MOCK_ENTRY(vkDestroyCommandPool),
+    _VS_MOCK_ENTRY(vkAllocateCommandBuffers),
+    _VS_MOCK_ENTRY(vkFreeCommandBuffers),
+    _VS_MOCK_ENTRY(vkAllocateMemory),
+    _VS_MOCK_ENTRY(vkFreeMemory),
+    _VS_MOCK_ENTRY(vkMapMemory),
+    _VS_MOCK_ENTRY(vkUnmapMemory),
+    _VS_MOCK_ENTRY(vkGetMemoryHostPointerPropertiesEXT),
+    _VS_MOCK_ENTRY(vkCreateBuffer),
+    _VS_MOCK_ENTRY(vkDestroyBuffer),
+    _VS_MOCK_ENTRY(vkGetBufferMemoryRequirements),
+    _VS_MOCK_ENTRY(vkBindBufferMemory),
+    _VS_MOCK_ENTRY(vkQueueSubmit),
+    _VS_MOCK_ENTRY(vkCreateFence),
+    _VS_MOCK_ENTRY(vkDestroyFence),
+    _VS_MOCK_ENTRY(vkResetFences),
+    _VS_MOCK_ENTRY(vkWaitForFences),
+    _VS_MOCK_ENTRY(vkResetCommandPool),
+    _VS_MOCK_ENTRY(vkBeginCommandBuffer),
+    _VS_MOCK_ENTRY(vkEndCommandBuffer),
+    _VS_MOCK_ENTRY(vkCmdCopyBuffer),
+    _VS_MOCK_ENTRY(vkCmdCopyBufferToImage),
+    _VS_MOCK_ENTRY(vkCmdPipelineBarrier2),
+    _VS_MOCK_ENTRY(vkFlushMappedMemoryRanges),
+    _VS_MOCK_ENTRY(vkCreateSemaphore),
+    _VS_MOCK_ENTRY(vkDestroySemaphore),
+    _VS_MOCK_ENTRY(vkGetSemaphoreCounterValue),
+    _VS_MOCK_ENTRY(vkWaitSemaphores),
+    _VS_MOCK_ENTRY(vkCmdDraw),
+};
+
+// Device level entry points going straight to the driver, as the ones of a real ICD
+static const _vs_mock_entry_point _mock_driver_entry_points[] =
+{
+    { "vkQueueSubmit2", (PFN_vkVoidFunction)_vs_mock_vkQueueSubmit2 },
+    { "vkGetFenceStatus", (PFN_vkVoidFunction)_vs_mock_vkGetFenceStatus },
+    { "vkCmdDraw", (PFN_vkVoidFunction)_vs_mock_vkCmdDraw },
+};
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetInstanceProcAddr(VkInstance instance, const char *pName)
+{
+    (void)instance;
+    for(uint32_t i = 0; i < sizeof(_mock_entry_points) / sizeof(_mock_entry_points[0]); i++)
+    {
+        if(strcmp(_mock_entry_points[i].name, pName) == 0)
+        {
+            return _mock_entry_points[i].func;
+        }
+    }
+    return NULL;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetDeviceProcAddr(VkDevice device, const char *pName)
+{
+    for(uint32_t i = 0; i < _mock.hidden_command_count; i++)
+    {
+        if(strcmp(_mock.hidden_commands[i], pName) == 0)
+        {
+            return NULL;
+        }
+    }
+    for(uint32_t i = 0; i < sizeof(_mock_driver_entry_points) / sizeof(_mock_driver_entry_points[0]); i++)
+    {
+        if(strcmp(_mock_driver_entry_points[i].name, pName) == 0)
+        {
+            return _mock_driver_entry_points[i].func;
+        }
+    }
+    return vkGetInstanceProcAddr( (VkInstance)device, pName );
+}
+
+// ###########
+// ### ICD ###
+// ###########
+
+// Entry points looked up by a Vulkan loader when the mock is listed in an ICD manifest (see `mock_vulkan_icd.json`)
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vk_icdNegotiateLoaderICDInterfaceVersion(uint32_t *pSupportedVersion)
+{
+    // Version 5 : the loader queries the instance version through `vk_icdGetInstanceProcAddr`
+    if(*pSupportedVersion > 5)
+    {
+        *pSupportedVersion = 5;
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vk_icdGetInstanceProcAddr(VkInstance instance, const char *pName)
+{
+    return vkGetInstanceProcAddr(instance, pName);
+}
@@ -0,0 +1,368 @@
+/**
+ * @file mock_vulkan.h
+ * @brief A stand-in Vulkan driver used to test `cvkstart` without a GPU
+ */
+
+/*
+ * NOTES :
+ *
+ * The mock implements the Vulkan entry points used by `cvkstart` as plain exported symbols, so test programs link
+ * against `mock_vulkan.c` instead of `libvulkan`. Every physical device entry point counts its calls per device.
+ *
+ * The exported hot path commands (`vkQueueSubmit2`, `vkGetFenceStatus`, `vkCmdDraw`) stand for loader trampolines :
+ * they go through the dispatch table stored in the handle, while `vkGetDeviceProcAddr` returns the driver functions.
+ *
+ * Built as a shared library, the mock is also an ICD : `mock_vulkan_icd.json` is a manifest the system loader can be
+ * pointed to (with `VK_DRIVER_FILES`), and dispatchable handles start with the slot the loader writes into.
+ *
+ */
+
+#ifndef __MOCK_VULKAN_H__
+#define __MOCK_VULKAN_H__
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifndef VS_MOCK_MAX_PHYSICAL_DEVICES
+#define VS_MOCK_MAX_PHYSICAL_DEVICES 64
+#endif
+
+#ifndef VS_MOCK_MAX_QUEUE_FAMILIES
+#define VS_MOCK_MAX_QUEUE_FAMILIES 16
+#endif
+
+#ifndef VS_MOCK_MAX_RECORDED_NAMES
+#define VS_MOCK_MAX_RECORDED_NAMES 16
+#endif
+
+/**
+ * @brief The number of calls made to each physical device entry point
+ */
+typedef struct
+{
+    uint32_t    get_properties;
+    uint32_t    get_properties2;
+    uint32_t    get_features;
+    uint32_t    get_features2;
+    uint32_t    get_memory_properties;
+    uint32_t    get_memory_properties2;
+    uint32_t    get_queue_family_properties;
+    uint32_t    enumerate_extensions;
+    uint32_t    get_surface_support;
+    uint32_t    get_format_properties;
+    uint32_t    get_format_properties2;
+    uint32_t    get_image_format_properties;
+} vs_mock_call_counts;
+
+/**
+ * @brief A physical device exposed by the mock, every field can be modified before the device is enumerated
+ */
+typedef struct
+{
+    /**
+     * @brief Reserved for the Vulkan loader, which stores its dispatch table there when the mock is used as an ICD
+     */
+    void                               *loader_data;
+
+    VkPhysicalDeviceProperties          properties;
+    uint8_t                             device_uuid[VK_UUID_SIZE];
+    VkPhysicalDeviceFeatures            features;
+    VkPhysicalDeviceVulkan11Features    features_11;
+    VkPhysicalDeviceVulkan12Features    features_12;
+    VkPhysicalDeviceVulkan13Features    features_13;
+    VkPhysicalDeviceMemoryProperties    memory_properties;
+
+    /**
+     * @brief The budgets and usages reported with `VK_EXT_memory_budget`, a zero budget stands for the heap size
+     */
+    VkDeviceSize                        heap_budgets[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize                        heap_usages[VK_MAX_MEMORY_HEAPS];
+
+    uint32_t                            queue_family_count;
+    VkQueueFamilyProperties             queue_families[VS_MOCK_MAX_QUEUE_FAMILIES];
+
+    /**
+     * @brief Wether or not each queue family can present (to any surface)
+     */
+    VkBool32                            present_support[VS_MOCK_MAX_QUEUE_FAMILIES];
+
+    /**
+     * @brief The supported extensions, the strings are not copied and must outlive the device
+     */
+    uint32_t                            extension_count;
+    const char                * const  *extensions;
+
+    /**
+     * @brief The highest global queue priority that is permitted, `VK_QUEUE_GLOBAL_PRIORITY_MEDIUM_KHR` if zero
+     */
+    VkQueueGlobalPriorityKHR            max_global_priority;
+
+    /**
+     * @brief Replaces the image format properties of a format, for every supported image, ignored if
+     *        `VK_FORMAT_UNDEFINED`
+     */
+    VkFormat                            image_format_override;
+    VkImageFormatProperties             image_format_override_properties;
+
+    /**
+     * @brief The `minImportedHostPointerAlignment` of `VK_EXT_external_memory_host`, 4096 by default
+     */
+    VkDeviceSize                        min_imported_host_pointer_alignment;
+
+    /**
+     * @brief Number of calls made by the library on this device
+     */
+    vs_mock_call_counts                 calls;
+} vs_mock_physical_device;
+
+/**
+ * @brief Information recorded from the last successful `vkCreateDevice` call
+ */
+typedef struct
+{
+    VkPhysicalDevice           physical_device;
+    uint32_t                   queue_create_info_count;
+    VkDeviceQueueCreateInfo    queue_create_infos[VS_MOCK_MAX_QUEUE_FAMILIES];
+    uint32_t                   enabled_extension_count;
+
+    /**
+     * @brief The priorities of each create info, as `queue_create_infos` do not point to them anymore
+     */
+    float                      queue_priorities[VS_MOCK_MAX_QUEUE_FAMILIES][64];
+
+    /**
+     * @brief The global priority chained to each create info, zero if none
+     */
+    VkQueueGlobalPriorityKHR   global_priorities[VS_MOCK_MAX_QUEUE_FAMILIES];
+
+    /**
+     * @brief The number of `vkCreateDevice` calls refused because of their global priorities
+     */
+    uint32_t                   refused_global_priority_count;
+
+    /**
+     * @brief The enabled features, either from `pEnabledFeatures` or from the `pNext` chain
+     */
+    VkPhysicalDeviceFeatures            features;
+    VkPhysicalDeviceVulkan11Features    features_11;
+    VkPhysicalDeviceVulkan12Features    features_12;
+    VkPhysicalDeviceVulkan13Features    features_13;
+
+    /**
+     * @brief The `synchronization2` feature of `VK_KHR_synchronization2`, supported like the Vulkan 1.3 one
+     */
+    VkBool32                            synchronization2;
+} vs_mock_device_creation;
+
+/**
+ * @brief Counters of the queue submissions made to the mock
+ */
+typedef struct
+{
+    uint64_t    submit_calls;
+    uint64_t    submit_infos;
+    uint64_t    fenced_submit_calls;
+} vs_mock_submit_stats;
+
+/**
+ * @brief Counters of the draws recorded to the mock
+ */
+typedef struct
+{
+    uint64_t    draw_calls;
+    uint64_t    vertices;
+} vs_mock_draw_stats;
+
+/**
+ * @brief Counters of the device memory allocated from the mock
+ */
+typedef struct
+{
+    uint64_t        allocate_calls;
+    uint64_t        free_calls;
+    uint64_t        map_calls;
+    uint32_t        live_allocations;
+    uint32_t        dedicated_allocations;
+    VkDeviceSize    live_bytes;
+
+    /**
+     * @brief The allocations importing a host pointer (`VK_EXT_external_memory_host`)
+     */
+    uint64_t        imported_allocations;
+
+    /**
+     * @brief The regions copied by `vkCmdCopyBuffer`, which the mock performs as soon as they are recorded
+     */
+    uint64_t        copy_regions;
+    VkDeviceSize    copied_bytes;
+    uint64_t        image_copy_regions;
+
+    /**
+     * @brief The `bufferOffset` of the last region given to `vkCmdCopyBufferToImage`
+     */
+    VkDeviceSize    image_copy_offset;
+
+    /**
+     * @brief The barriers recorded with `vkCmdPipelineBarrier2`, and the ones among them transferring a queue family
+     *        ownership (releases and acquires)
+     */
+    uint64_t        buffer_barriers;
+    uint64_t        image_barriers;
+    uint64_t        ownership_transfers;
+
+    /**
+     * @brief The ranges given to `vkFlushMappedMemoryRanges`
+     */
+    uint64_t        flushed_ranges;
+} vs_mock_memory_stats;
+
+/**
+ * @brief Counters of the command pools and command buffers, updated atomically as threads record concurrently
+ */
+typedef struct
+{
+    _Atomic uint64_t    created_pools;
+    _Atomic uint64_t    destroyed_pools;
+    _Atomic uint64_t    pool_resets;
+    _Atomic uint64_t    allocate_calls;
+    _Atomic uint64_t    allocated_buffers;
+    _Atomic uint64_t    freed_buffers;
+} vs_mock_command_stats;
+
+/**
+ * @brief Information recorded from the last `vkCreateInstance` call
+ */
+typedef struct
+{
+    uint32_t                         enabled_layer_count;
+    uint32_t                         enabled_extension_count;
+    char                             enabled_extensions[VS_MOCK_MAX_RECORDED_NAMES][VK_MAX_EXTENSION_NAME_SIZE];
+
+    /**
+     * @brief The boolean settings chained with `VkLayerSettingsCreateInfoEXT`
+     */
+    uint32_t                         layer_setting_count;
+    char                             layer_settings[VS_MOCK_MAX_RECORDED_NAMES][VK_MAX_EXTENSION_NAME_SIZE];
+    VkBool32                         layer_setting_values[VS_MOCK_MAX_RECORDED_NAMES];
+
+    /**
+     * @brief The features chained with `VkValidationFeaturesEXT`
+     */
+    uint32_t                         validation_enable_count;
+    VkValidationFeatureEnableEXT     validation_enables[VS_MOCK_MAX_RECORDED_NAMES];
+    uint32_t                         validation_disable_count;
+    VkValidationFeatureDisableEXT    validation_disables[VS_MOCK_MAX_RECORDED_NAMES];
+} vs_mock_instance_creation;
+
+/**
+ * @brief The debug utils messenger created on the mock instance, the mock exposes the validation layer
+ */
+typedef struct
+{
+    bool                                    created;
+    VkDebugUtilsMessageSeverityFlagsEXT     severities;
+    VkDebugUtilsMessageTypeFlagsEXT         types;
+    PFN_vkDebugUtilsMessengerCallbackEXT    callback;
+    void                                   *user_data;
+} vs_mock_debug_messenger;
+
+/**
+ * @brief Removes all physical devices and resets all counters
+ */
+void                     vs_mock_reset(void);
+
+/**
+ * @brief Adds a physical device to the mock, with a typical desktop queue family layout
+ *
+ * @param name The name of the device
+ * @param type The type of the device
+ * @return The device, or NULL if `VS_MOCK_MAX_PHYSICAL_DEVICES` devices were already added
+ */
+vs_mock_physical_device *vs_mock_add_physical_device(const char *name, VkPhysicalDeviceType type);
+
+/**
+ * @brief Gets the mock device behind a physical device handle
+ */
+vs_mock_physical_device *vs_mock_physical_device_get(VkPhysicalDevice physical_device);
+
+/**
+ * @brief Gets the information recorded by the last `vkCreateDevice` call
+ */
+const vs_mock_device_creation *vs_mock_last_device_creation(void);
+
+/**
+ * @brief Gets the counters of the queue submissions
+ */
+const vs_mock_submit_stats *vs_mock_submit_stats_get(void);
+
+/**
+ * @brief Gets the counters of the recorded draws
+ */
+const vs_mock_draw_stats *vs_mock_draw_stats_get(void);
+
+/**
+ * @brief Sets the time spent in each `vkQueueSubmit2` call, to stand for the cost of a real driver (zero by default)
+ */
+void                     vs_mock_set_submit_cost(uint32_t nanoseconds);
+
+/**
+ * @brief Gets the counters of the device memory allocations
+ */
+const vs_mock_memory_stats *vs_mock_memory_stats_get(void);
+
+/**
+ * @brief Sets the time spent in each `vkAllocateMemory` call, to stand for the kernel round trip of a real driver (zero
+ *        by default)
+ * @note Allocations past the `maxMemoryAllocationCount` of the last created device fail with
+ *       `VK_ERROR_TOO_MANY_OBJECTS`.
+ */
+void                     vs_mock_set_allocation_cost(uint32_t nanoseconds);
+
+/**
+ * @brief Gets the counters of the command pools
+ */
+const vs_mock_command_stats *vs_mock_command_stats_get(void);
+
+/**
+ * @brief Sets the time spent in each `vkAllocateCommandBuffers`, `vkFreeCommandBuffers` and `vkResetCommandPool` call,
+ *        to stand for the bookkeeping of a real driver (zero by default)
+ */
+void                     vs_mock_set_command_buffer_cost(uint32_t nanoseconds);
+
+/**
+ * @brief Makes `vkGetDeviceProcAddr` return NULL for a command, as a driver lacking it would (reset by `vs_mock_reset`)
+ * @note The name is not copied.
+ */
+void                     vs_mock_hide_device_command(const char *name);
+
+/**
+ * @brief Stops completing the `vkQueueSubmit` and `vkQueueSubmit2` calls, so that their fences and semaphores stay
+ *        unsignaled until the GPU is resumed or they are waited for
+ */
+void                     vs_mock_set_gpu_paused(bool paused);
+
+/**
+ * @brief Gets the information recorded by the last `vkCreateInstance` call
+ */
+const vs_mock_instance_creation *vs_mock_last_instance_creation(void);
+
+/**
+ * @brief Makes the validation layer only provide `VK_EXT_validation_features`, like layers older than
+ *        `VK_EXT_layer_settings` (reset by `vs_mock_reset`)
+ */
+void                     vs_mock_set_legacy_validation_layer(bool legacy);
+
+/**
+ * @brief Gets the debug utils messenger created on the mock instance
+ */
+const vs_mock_debug_messenger *vs_mock_debug_messenger_get(void);
+
+/**
+ * @brief Reports a validation message to the debug utils messenger, as a validation layer would
+ *
+ * @return Wether or not the messenger subscribed to `severity` and received the message
+ */
+bool                     vs_mock_emit_debug_message(VkDebugUtilsMessageSeverityFlagBitsEXT severity, int32_t message_id, const char *message);
+
+#endif //__MOCK_VULKAN_H__
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <dlfcn.h>
+//#include "cvkstart.h"
+#include "cvkstart.c"
+#include "mock_vulkan.h"
+
+// Tests of the meta loader mode (built with `VS_LOADER`), loading the stand-in driver built as a shared library
+// Usage : test_loader <path to the stand-in driver>
+
+#define CHECK(cond)                                                         \
+        if( !(cond) )                                                       \
+        {                                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return false;                                                   \
+        }
+
+static const char *_test_mock_path;
+
+/**
+ * @brief Gets a symbol of the stand-in driver, that `vs_loader_init` already opened
+ */
+void *
+_test_mock_symbol(const char *name)
+{
+    void *library = dlopen(_test_mock_path, RTLD_NOW | RTLD_NOLOAD);
+    void *symbol  = library ? dlsym(library, name) : NULL;
+    if(library)
+    {
+        dlclose(library);
+    }
+    return symbol;
+}
+
+bool
+test_loader_stages(void)
+{
+    CHECK( !vs_loader_init("libvs_does_not_exist.so") );
+    CHECK(vkCreateInstance == NULL);
+
+    // Global stage
+    CHECK( vs_loader_init(_test_mock_path) );
+    CHECK(vkGetInstanceProcAddr != NULL && vkCreateInstance != NULL && vkEnumerateInstanceVersion != NULL);
+    CHECK(vkEnumeratePhysicalDevices == NULL);
+
+    void (*mock_reset)(void)                                                = (void (*)(void))(uintptr_t)_test_mock_symbol("vs_mock_reset");
+    vs_mock_physical_device *(*mock_add)(const char *, VkPhysicalDeviceType) = (vs_mock_physical_device *(*)(const char *, VkPhysicalDeviceType))(uintptr_t)_test_mock_symbol("vs_mock_add_physical_device");
+    CHECK(mock_reset != NULL && mock_add != NULL);
+    mock_reset();
+    mock_add("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    // Instance stage, done by the instance builder
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    CHECK(vkEnumeratePhysicalDevices != NULL && vkCreateDevice != NULL && vkGetDeviceProcAddr != NULL);
+    CHECK(vkQueueSubmit2 == (PFN_vkQueueSubmit2)(uintptr_t)_test_mock_symbol("vkQueueSubmit2") );
+
+    VkQueue          queue;
+    vs_queue_request request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    VkPhysicalDevice physical_device  = vs_select_physical_device( (vs_physical_device_selector){ .required_queue_count = 1, .required_queues = &request }, instance);
+    CHECK(physical_device != VK_NULL_HANDLE);
+    VkDevice device = vs_device_create(physical_device, (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request }, instance);
+    CHECK(device != VK_NULL_HANDLE && queue != VK_NULL_HANDLE);
+
+    // Device stage, the hot path commands come straight from the driver instead of its trampolines
+    vs_loader_load_device(device);
+    CHECK(vkQueueSubmit2 != NULL && vkQueueSubmit2 != (PFN_vkQueueSubmit2)(uintptr_t)_test_mock_symbol("vkQueueSubmit2") );
+    VkSubmitInfo2 submit = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
+    CHECK(vkQueueSubmit2(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
+
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+
+    vs_loader_terminate();
+    CHECK(vkGetInstanceProcAddr == NULL && vkQueueSubmit2 == NULL);
+    return true;
+}
+
+// ## Runner
+
+typedef struct
+{
+    const char   *name;
+    bool (*func)(void);
+} test_case;
+
+#define TEST_CASE(f) { #f, f }
+
+static const test_case tests[] =
+{
+    TEST_CASE(test_loader_stages),
+};
+
+int
+main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        printf("Usage : %s <path to the stand-in driver>\n", argv[0]);
+        return 1;
+    }
+    _test_mock_path = argv[1];
+
+    uint32_t failed = 0;
+    for(uint32_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        bool ok = tests[i].func();
+        printf("[%s] %s\n", ok ? " OK " : "FAIL", tests[i].name);
+        failed += ok ? 0 : 1;
+    }
+
+    if(failed)
+    {
+        printf("%u test(s) failed\n", failed);
+        return 1;
+    }
+    printf("All ok\n");
+    return 0;
+}
@@ -0,0 +1,2211 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+//#include "cvkstart.h"
+#include "cvkstart.c"
+#include "mock_vulkan.h"
+
+// Tests running `cvkstart` against the stand-in driver of `mock_vulkan.c`
+
+#define CHECK(cond)                                                         \
+        if( !(cond) )                                                       \
+        {                                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return false;                                                   \
+        }
+
+static const char *_test_extensions[] =
+{
+    "VK_KHR_swapchain",
+    "VK_KHR_maintenance4",
+    "VK_EXT_memory_budget",
+};
+
+// ## Host allocations
+
+typedef struct
+{
+    _Atomic uint32_t    allocations;
+    _Atomic uint32_t    frees;
+} _test_host_allocator;
+
+void *
+_test_host_allocation(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    (void)scope;
+    ( (_test_host_allocator *)user_data )->allocations++;
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void
+_test_host_free(void *user_data, void *memory)
+{
+    ( (_test_host_allocator *)user_data )->frees += memory != NULL;
+    free(memory);
+}
+
+// ## Physical device information
+
+static vs_physical_device_info _test_info;
+
+bool
+test_query_count(void)
+{
+    vs_mock_reset();
+    for(uint32_t i = 0; i < 8; i++)
+    {
+        vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+        dev->extension_count         = 3;
+        dev->extensions              = _test_extensions;
+
+        // Only the last device is suitable, so that every device is evaluated
+        dev->features.geometryShader = i == 7;
+    }
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+
+    vs_queue_request requests[3] =
+    {
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT },
+        { .required_flags = VK_QUEUE_COMPUTE_BIT },
+        { .required_flags = VK_QUEUE_TRANSFER_BIT },
+    };
+    char *required_extensions[] = { "VK_KHR_swapchain", "VK_EXT_memory_budget" };
+
+    CHECK(
+        vs_select_physical_device_info(
+            (vs_physical_device_selector)
+            {
+                .minimum_version                  = VK_API_VERSION_1_2,
+                .surface                          = (VkSurfaceKHR)(uintptr_t)0x5u,
+                .require_present_queue            = true,
+                .required_queue_count             = 3,
+                .required_queues                  = requests,
+                .required_extension_count         = 2,
+                .required_extensions              = required_extensions,
+                .required_features.geometryShader = true,
+                .required_types                   = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
+            },
+            instance,
+            &_test_info
+            )
+        );
+
+    VkQueue queues[3]  = { 0 };
+    VkQueue present    = VK_NULL_HANDLE;
+    requests[0].destination = &queues[0];
+    requests[1].destination = &queues[1];
+    requests[2].destination = &queues[2];
+
+    VkDevice device = vs_device_create(
+        _test_info.physical_device,
+        (vs_device_builder)
+        {
+            .queue_request_count     = 3,
+            .queue_requests          = requests,
+            .request_present_queue   = true,
+            .surface                 = (VkSurfaceKHR)(uintptr_t)0x5u,
+            .present_destination     = &present,
+            .features.geometryShader = true,
+            .physical_device_info    = &_test_info,
+        },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+    CHECK(queues[0] && queues[1] && queues[2] && present);
+
+    // Each entry point must have been called at most once per device, and surface support at most once per family
+    uint32_t phydev_count = 8;
+    VkPhysicalDevice phydevs[8];
+    vkEnumeratePhysicalDevices(instance.vk_instance, &phydev_count, phydevs);
+    for(uint32_t i = 0; i < phydev_count; i++)
+    {
+        vs_mock_physical_device *dev = vs_mock_physical_device_get(phydevs[i]);
+        CHECK(dev->calls.get_properties <= 1);
+        CHECK(dev->calls.get_properties2 <= 1);
+        CHECK(dev->calls.get_features + dev->calls.get_features2 <= 1);
+        CHECK(dev->calls.get_memory_properties <= 1);
+        CHECK(dev->calls.get_queue_family_properties <= 1);
+        CHECK(dev->calls.enumerate_extensions <= 1);
+        CHECK(dev->calls.get_surface_support <= dev->queue_family_count);
+    }
+    CHECK(_test_info.physical_device == phydevs[7]);
+
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Selection cache
+
+bool
+test_selection_cache(void)
+{
+    const char *cache_path = "/tmp/cvkstart_test_cache.bin";
+    unlink(cache_path);
+
+    vs_mock_reset();
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+        dev->extension_count         = 3;
+        dev->extensions              = _test_extensions;
+        dev->features.geometryShader = i >= 2;
+    }
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+
+    VkQueue queues[2]          = { 0 };
+    vs_queue_request requests[2] =
+    {
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queues[0] },
+        { .required_flags = VK_QUEUE_TRANSFER_BIT, .destination = &queues[1] },
+    };
+    vs_physical_device_selector selector =
+    {
+        .required_queue_count             = 2,
+        .required_queues                  = requests,
+        .required_features.geometryShader = true,
+        .cache_path                       = cache_path,
+    };
+    vs_device_builder builder =
+    {
+        .queue_request_count = 2,
+        .queue_requests      = requests,
+        .cache_path          = cache_path,
+    };
+
+    // Cold start, writes the cache
+    VkPhysicalDevice cold = vs_select_physical_device(selector, instance);
+    CHECK(cold != VK_NULL_HANDLE);
+    CHECK(vs_device_create(cold, builder, instance) != VK_NULL_HANDLE);
+    VkQueue cold_queues[2] = { queues[0], queues[1] };
+
+    // Warm start, only the identity of devices is queried
+    VkPhysicalDevice phydevs[4];
+    uint32_t phydev_count = 4;
+    vkEnumeratePhysicalDevices(instance.vk_instance, &phydev_count, phydevs);
+    for(uint32_t i = 0; i < phydev_count; i++)
+    {
+        memset(&vs_mock_physical_device_get(phydevs[i])->calls, 0, sizeof(vs_mock_call_counts));
+    }
+    queues[0] = queues[1] = VK_NULL_HANDLE;
+
+    VkPhysicalDevice warm = vs_select_physical_device(selector, instance);
+    CHECK(warm == cold);
+    CHECK(vs_device_create(warm, builder, instance) != VK_NULL_HANDLE);
+    CHECK(queues[0] == cold_queues[0] && queues[1] == cold_queues[1]);
+    CHECK(vs_mock_last_device_creation()->queue_create_info_count == 2);
+
+    for(uint32_t i = 0; i < phydev_count; i++)
+    {
+        vs_mock_physical_device *dev = vs_mock_physical_device_get(phydevs[i]);
+        if(phydevs[i] != warm)
+        {
+            CHECK(dev->calls.get_features == 0 && dev->calls.enumerate_extensions == 0);
+        }
+    }
+
+    // Queried by the selection, and by the creation to validate the queue assignment read from the cache
+    vs_mock_physical_device *selected = vs_mock_physical_device_get(warm);
+    CHECK(selected->calls.get_queue_family_properties == 2);
+
+    // A cached queue the family does not have is not trusted, the assignment is made again
+    _vs_cache_file tampered;
+    CHECK(_vs_cache_read(cache_path, &tampered) && tampered.queue_write_count == 2);
+    tampered.queue_writes[1].queue_index = 1000;
+    _vs_cache_write(cache_path, &tampered);
+    queues[0] = queues[1] = VK_NULL_HANDLE;
+    CHECK(vs_device_create(warm, builder, instance) != VK_NULL_HANDLE);
+    CHECK(queues[0] == cold_queues[0] && queues[1] == cold_queues[1]);
+    CHECK(_vs_cache_read(cache_path, &tampered) && tampered.queue_writes[1].queue_index < 2);
+
+    // Preferring an extension only another device has changes the selection, despite the cache
+    static const char *more_extensions[] = { "VK_KHR_swapchain", "VK_KHR_maintenance4", "VK_EXT_memory_budget", "VK_EXT_preferred" };
+    char              *preferred[]       = { "VK_EXT_preferred" };
+    VkPhysicalDevice   other             = VK_NULL_HANDLE;
+    for(uint32_t i = 0; i < phydev_count; i++)
+    {
+        if(phydevs[i] != warm && vs_mock_physical_device_get(phydevs[i])->features.geometryShader)
+        {
+            other = phydevs[i];
+        }
+    }
+    vs_mock_physical_device_get(other)->extension_count = 4;
+    vs_mock_physical_device_get(other)->extensions      = more_extensions;
+    vs_physical_device_selector preferring = selector;
+    preferring.preferred_extension_count = 1;
+    preferring.preferred_extensions      = preferred;
+    CHECK(vs_select_physical_device(preferring, instance) == other);
+    CHECK(vs_select_physical_device(selector, instance) == warm);
+
+    // A driver update invalidates the cache
+    selected->properties.driverVersion++;
+    selected->features.geometryShader = false;
+    CHECK(vs_select_physical_device(selector, instance) != warm);
+
+    vs_instance_destroy(instance);
+    unlink(cache_path);
+    return true;
+}
+
+// ## Name sets
+
+bool
+test_name_sets(void)
+{
+    VkExtensionProperties props[4] =
+    {
+        { .extensionName = "VK_KHR_swapchain" },
+        { .extensionName = "VK_KHR_maintenance4" },
+        { .extensionName = "VK_EXT_memory_budget" },
+        { .extensionName = "VK_KHR_swapchain" },
+    };
+    uint16_t slots[VS_NAME_SET_SLOT_COUNT(4)];
+    vs_name_set set;
+    vs_name_set_build(&set, props[0].extensionName, sizeof(VkExtensionProperties), 4, slots);
+
+    CHECK( vs_name_set_contains(&set, "VK_KHR_maintenance4") );
+    CHECK( !vs_name_set_contains(&set, "VK_KHR_maintenance5") );
+    CHECK( !vs_name_set_contains(&set, "") );
+
+    char *wanted[] = { "VK_EXT_memory_budget", "VK_EXT_mesh_shader", "VK_KHR_swapchain", "VK_KHR_ray_query" };
+    char *missing[4];
+    CHECK( vs_name_set_missing(&set, 4, wanted, NULL) == 2 );
+    CHECK( vs_name_set_missing(&set, 4, wanted, missing) == 2 );
+    CHECK( strcmp(missing[0], "VK_EXT_mesh_shader") == 0 && strcmp(missing[1], "VK_KHR_ray_query") == 0 );
+
+    // Unsupported instance extensions must be rejected
+    char *instance_exts[] = { "VK_KHR_surface", "VK_KHR_xlib_surface" };
+    CHECK( vs_instance_missing_extensions(2, instance_exts, missing) == 1 );
+    CHECK( strcmp(missing[0], "VK_KHR_xlib_surface") == 0 );
+
+    vs_instance instance;
+    CHECK( !vs_instance_builder_build( (vs_instance_builder){ .requested_extension_count = 2, .requested_extensions = instance_exts }, &instance ) );
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .requested_extension_count = 1, .requested_extensions = instance_exts }, &instance ) );
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Features
+
+bool
+test_features(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *without = vs_mock_add_physical_device("Mock GPU without timeline", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    vs_mock_physical_device *old     = vs_mock_add_physical_device("Mock GPU 1.1", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    vs_mock_physical_device *with    = vs_mock_add_physical_device("Mock GPU with timeline", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    without->features_13.dynamicRendering = true;
+
+    // Only queried through the structures of its version, so the 1.2 and 1.3 features must not be seen
+    old->properties.apiVersion         = VK_API_VERSION_1_1;
+    old->features_12.timelineSemaphore = true;
+    old->features_13.dynamicRendering  = true;
+
+    with->features.geometryShader       = true;
+    with->features_12.timelineSemaphore = true;
+    with->features_13.dynamicRendering  = true;
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+
+    CHECK(
+        vs_select_physical_device_info(
+            (vs_physical_device_selector)
+            {
+                .minimum_version                        = VK_API_VERSION_1_1,
+                .required_features_12.timelineSemaphore = true,
+                .required_features_13.dynamicRendering  = true,
+            },
+            instance,
+            &_test_info
+            )
+        );
+    CHECK(vs_mock_physical_device_get(_test_info.physical_device) == with);
+    CHECK(with->calls.get_features == 0 && with->calls.get_features2 == 1);
+    CHECK(old->calls.get_features2 <= 1);
+
+    // Only the 1.3 structure has a feature enabled, so the 1.2 one must not be chained
+    VkDevice device = vs_device_create(
+        _test_info.physical_device,
+        (vs_device_builder)
+        {
+            .features.geometryShader      = true,
+            .features_13.dynamicRendering = true,
+            .physical_device_info         = &_test_info,
+        },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+    const vs_mock_device_creation *rec = vs_mock_last_device_creation();
+    CHECK(rec->features.geometryShader && rec->features_13.dynamicRendering);
+    CHECK(rec->features_12.sType == 0);
+    vs_device_destroy(device, instance);
+
+    // Unsupported features are refused by the driver
+    device = vs_device_create(
+        _test_info.physical_device,
+        (vs_device_builder){ .features_11.multiview = true, .physical_device_info = &_test_info },
+        instance
+        );
+    CHECK(device == VK_NULL_HANDLE);
+    vs_instance_destroy(instance);
+
+    // An instance created for Vulkan 1.0 only uses the Vulkan 1.0 queries, whatever the device version
+    memset(&with->calls, 0, sizeof(vs_mock_call_counts) );
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .required_api_version = VK_API_VERSION_1_0 }, &instance ) );
+    CHECK(instance.api_version == VK_API_VERSION_1_0);
+    vs_physical_device_info_query( (VkPhysicalDevice)with, VK_NULL_HANDLE, instance, &_test_info );
+    CHECK(_test_info.api_version == VK_API_VERSION_1_0 && !_test_info.features_13.dynamicRendering);
+    CHECK(with->calls.get_features == 1 && with->calls.get_features2 == 0 && with->calls.get_properties2 == 0);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Ranking
+
+bool
+test_ranking(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *igpu  = vs_mock_add_physical_device("Mock iGPU", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU);
+    vs_mock_physical_device *small = vs_mock_add_physical_device("Mock small dGPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    vs_mock_physical_device *big   = vs_mock_add_physical_device("Mock big dGPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    // Integrated GPUs usually expose a single universal family
+    igpu->queue_family_count                     = 1;
+    small->memory_properties.memoryHeaps[0].size = 4ull << 30;
+    big->memory_properties.memoryHeaps[0].size   = 16ull << 30;
+    small->properties.limits.maxComputeWorkGroupInvocations = 2048;
+    big->properties.limits.maxComputeWorkGroupInvocations   = 1024;
+
+    // The snapshots of the devices go through the allocation callbacks
+    _test_host_allocator  host_allocator = { 0 };
+    VkAllocationCallbacks callbacks      = { .pUserData = &host_allocator, .pfnAllocation = _test_host_allocation, .pfnFree = _test_host_free };
+    vs_instance           instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .allocation_callbacks = &callbacks }, &instance ) );
+
+    // The first enumerated device is not the best one
+    CHECK( vs_select_physical_device( (vs_physical_device_selector){ 0 }, instance ) == (VkPhysicalDevice)big );
+    CHECK(host_allocator.allocations == 2 && host_allocator.frees == 2);
+    CHECK( vs_select_physical_device( (vs_physical_device_selector){ .preferred_type = VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU }, instance ) == (VkPhysicalDevice)igpu );
+
+    vs_limit_weight weights[] = { VS_LIMIT_WEIGHT(maxComputeWorkGroupInvocations, 1.0f) };
+    vs_physical_device_selector weighted = { .limit_weight_count = 1, .limit_weights = weights };
+    CHECK( vs_select_physical_device(weighted, instance) == (VkPhysicalDevice)small );
+
+    uint32_t count       = 0;
+    uint32_t allocations = host_allocator.allocations;
+    vs_enumerate_suitable_devices(weighted, instance, &count, NULL);
+    CHECK(count == 3 && host_allocator.allocations == allocations + 1);
+
+    vs_suitable_device ranked[3];
+    count = 2;
+    vs_enumerate_suitable_devices(weighted, instance, &count, ranked);
+    CHECK(count == 2);
+    CHECK(ranked[0].physical_device == (VkPhysicalDevice)small && ranked[1].physical_device == (VkPhysicalDevice)big);
+    CHECK(ranked[0].score > ranked[1].score);
+
+    // Unsuitable devices are not listed
+    big->features.geometryShader = true;
+    count = 3;
+    vs_enumerate_suitable_devices( (vs_physical_device_selector){ .required_features.geometryShader = true }, instance, &count, ranked );
+    CHECK(count == 1 && ranked[0].physical_device == (VkPhysicalDevice)big);
+    CHECK(host_allocator.allocations > 0 && host_allocator.allocations == host_allocator.frees);
+
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Queue assignment
+
+#define _TEST_FAMILY(flags, count) (VkQueueFamilyProperties){ .queueFlags = (flags), .queueCount = (count), .timestampValidBits = 64 }
+
+#define G VK_QUEUE_GRAPHICS_BIT
+#define C VK_QUEUE_COMPUTE_BIT
+#define T VK_QUEUE_TRANSFER_BIT
+#define S VK_QUEUE_SPARSE_BINDING_BIT
+
+/**
+ * @brief Creates a device with the given requests, on a device which only has the given families
+ * @return The queue create infos recorded by the mock, or NULL if creation failed
+ */
+const vs_mock_device_creation *
+_test_create_with_layout(uint32_t family_count, const VkQueueFamilyProperties *families, uint32_t present_family,
+                         uint32_t request_count, vs_queue_request *requests, bool allow_shared, VkQueue *present)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    dev->queue_family_count = family_count;
+    memset(dev->present_support, 0, sizeof(dev->present_support) );
+    dev->present_support[present_family] = VK_TRUE;
+    memcpy(dev->queue_families, families, sizeof(VkQueueFamilyProperties) * family_count);
+
+    vs_instance instance;
+    if( !vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) )
+    {
+        return NULL;
+    }
+
+    VkSurfaceKHR surface = (VkSurfaceKHR)(uintptr_t)0x5u;
+    bool selected = vs_select_physical_device_info(
+        (vs_physical_device_selector)
+        {
+            .surface               = surface,
+            .require_present_queue = present != NULL,
+            .required_queue_count  = request_count,
+            .required_queues       = requests,
+            .allow_shared_queues   = allow_shared,
+        },
+        instance,
+        &_test_info
+        );
+
+    VkDevice device = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder)
+        {
+            .queue_request_count   = request_count,
+            .queue_requests        = requests,
+            .allow_shared_queues   = allow_shared,
+            .request_present_queue = present != NULL,
+            .surface               = surface,
+            .present_destination   = present,
+        },
+        instance
+        );
+
+    if(device != VK_NULL_HANDLE)
+    {
+        vs_device_destroy(device, instance);
+    }
+    vs_instance_destroy(instance);
+
+    // Selection and creation must agree
+    if( selected != (device != VK_NULL_HANDLE) )
+    {
+        printf("selection and creation disagree\n");
+        return NULL;
+    }
+    return device != VK_NULL_HANDLE ? vs_mock_last_device_creation() : NULL;
+}
+
+/**
+ * @brief Gets the number of queues created in a family
+ */
+uint32_t
+_test_family_queue_count(const vs_mock_device_creation *rec, uint32_t family)
+{
+    for(uint32_t i = 0; i < rec->queue_create_info_count; i++)
+    {
+        if(rec->queue_create_infos[i].queueFamilyIndex == family)
+        {
+            return rec->queue_create_infos[i].queueCount;
+        }
+    }
+    return 0;
+}
+
+bool
+test_queue_layouts(void)
+{
+    VkQueue queues[4] = { 0 };
+    VkQueue present   = VK_NULL_HANDLE;
+    vs_queue_request requests[4];
+    const vs_mock_device_creation *rec;
+
+    // NVIDIA like : universal, transfer, async compute
+    VkQueueFamilyProperties nvidia[] = { _TEST_FAMILY(G | C | T | S, 16), _TEST_FAMILY(T | S, 2), _TEST_FAMILY(C | T | S, 8) };
+    requests[0] = (vs_queue_request){ .required_flags = G, .destination = &queues[0] };
+    requests[1] = (vs_queue_request){ .required_flags = C, .destination = &queues[1] };
+    requests[2] = (vs_queue_request){ .required_flags = T, .destination = &queues[2] };
+    rec = _test_create_with_layout(3, nvidia, 0, 3, requests, false, &present);
+    CHECK(rec != NULL);
+    CHECK(_test_family_queue_count(rec, 0) == 1 && _test_family_queue_count(rec, 1) == 1 && _test_family_queue_count(rec, 2) == 1);
+    CHECK(present == queues[0]);
+
+    // AMD like : a single universal queue, the second transfer request goes to async compute rather than failing
+    VkQueueFamilyProperties amd[] = { _TEST_FAMILY(G | C | T | S, 1), _TEST_FAMILY(C | T | S, 4), _TEST_FAMILY(T | S, 1) };
+    requests[3] = (vs_queue_request){ .required_flags = T, .destination = &queues[3] };
+    rec = _test_create_with_layout(3, amd, 0, 4, requests, false, &present);
+    CHECK(rec != NULL);
+    CHECK(_test_family_queue_count(rec, 0) == 1 && _test_family_queue_count(rec, 1) == 2 && _test_family_queue_count(rec, 2) == 1);
+    CHECK(queues[2] != queues[3]);
+
+    // A generic transfer request must leave the only sparse transfer family to the request that needs it, which a
+    // greedy assignment in request order would not do
+    VkQueueFamilyProperties trap[] = { _TEST_FAMILY(G | C | T | S, 16), _TEST_FAMILY(T | S, 1), _TEST_FAMILY(C | T, 1) };
+    requests[0] = (vs_queue_request){ .required_flags = T, .destination = &queues[0] };
+    requests[1] = (vs_queue_request){ .required_flags = T | S, .destination = &queues[1] };
+    rec = _test_create_with_layout(3, trap, 0, 2, requests, false, NULL);
+    CHECK(rec != NULL);
+    CHECK(_test_family_queue_count(rec, 0) == 0 && _test_family_queue_count(rec, 1) == 1 && _test_family_queue_count(rec, 2) == 1);
+
+    // Intel like : a single universal queue, only usable by several requests when sharing is allowed
+    VkQueueFamilyProperties intel[] = { _TEST_FAMILY(G | C | T, 1) };
+    requests[0] = (vs_queue_request){ .required_flags = G, .destination = &queues[0] };
+    requests[1] = (vs_queue_request){ .required_flags = C, .destination = &queues[1] };
+    requests[2] = (vs_queue_request){ .required_flags = T, .destination = &queues[2] };
+    CHECK(_test_create_with_layout(1, intel, 0, 3, requests, false, &present) == NULL);
+    rec = _test_create_with_layout(1, intel, 0, 3, requests, true, &present);
+    CHECK(rec != NULL);
+    CHECK(_test_family_queue_count(rec, 0) == 1);
+    CHECK(queues[0] == queues[1] && queues[1] == queues[2] && present == queues[0]);
+
+    // Shared queues are spread over the family
+    VkQueueFamilyProperties two[] = { _TEST_FAMILY(G | C | T, 2) };
+    rec = _test_create_with_layout(1, two, 0, 3, requests, true, NULL);
+    CHECK(rec != NULL);
+    CHECK(_test_family_queue_count(rec, 0) == 2);
+    CHECK(queues[0] != queues[1] && queues[2] == queues[0]);
+
+    // Presentation only supported by the transfer family gets a dedicated queue
+    requests[0] = (vs_queue_request){ .required_flags = G, .destination = &queues[0] };
+    requests[1] = (vs_queue_request){ .required_flags = C, .destination = &queues[1] };
+    rec = _test_create_with_layout(3, nvidia, 1, 2, requests, false, &present);
+    CHECK(rec != NULL);
+    CHECK(_test_family_queue_count(rec, 1) == 1);
+    CHECK(present != queues[0] && present != queues[1]);
+
+    return true;
+}
+
+#undef G
+#undef C
+#undef T
+#undef S
+
+// ## Queue priorities
+
+bool
+test_queue_priorities(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    dev->max_global_priority     = VK_QUEUE_GLOBAL_PRIORITY_HIGH_KHR;
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+
+    VkQueue queues[4];
+    float   priorities[4] = { 1.0f, 0.5f, 0.25f, 0.1f };
+    vs_queue_request requests[4] =
+    {
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queues[0], .queue_priority = &priorities[0] },
+        { .required_flags = VK_QUEUE_COMPUTE_BIT, .destination = &queues[1], .queue_priority = &priorities[1] },
+        {
+            .required_flags  = VK_QUEUE_COMPUTE_BIT,
+            .destination     = &queues[2],
+            .queue_priority  = &priorities[2],
+            .global_priority = VK_QUEUE_GLOBAL_PRIORITY_HIGH_KHR,
+        },
+        {
+            .required_flags  = VK_QUEUE_TRANSFER_BIT,
+            .destination     = &queues[3],
+            .queue_priority  = &priorities[3],
+            .global_priority = VK_QUEUE_GLOBAL_PRIORITY_REALTIME_KHR,
+        },
+    };
+    char *extensions[] = { "VK_KHR_global_priority" };
+    vs_device_builder builder =
+    {
+        .queue_request_count    = 4,
+        .queue_requests         = requests,
+        .enable_extension_count = 1,
+        .enable_extensions      = extensions,
+    };
+
+    VkDevice device = vs_device_create( (VkPhysicalDevice)dev, builder, instance );
+    CHECK(device != VK_NULL_HANDLE);
+    vs_device_destroy(device, instance);
+
+    // Realtime is refused once, then both families get high
+    const vs_mock_device_creation *rec = vs_mock_last_device_creation();
+    CHECK(rec->refused_global_priority_count == 1);
+    CHECK(rec->queue_create_info_count == 3);
+    for(uint32_t i = 0; i < rec->queue_create_info_count; i++)
+    {
+        switch(rec->queue_create_infos[i].queueFamilyIndex)
+        {
+        case 0:
+            CHECK(rec->queue_create_infos[i].queueCount == 1 && rec->queue_priorities[i][0] == 1.0f);
+            CHECK(rec->global_priorities[i] == 0);
+            break;
+        case 1:
+            CHECK(rec->queue_create_infos[i].queueCount == 2);
+            CHECK(rec->queue_priorities[i][0] == 0.5f && rec->queue_priorities[i][1] == 0.25f);
+            CHECK(rec->global_priorities[i] == VK_QUEUE_GLOBAL_PRIORITY_HIGH_KHR);
+            break;
+        case 2:
+            CHECK(rec->queue_priorities[i][0] == 0.1f);
+            CHECK(rec->global_priorities[i] == VK_QUEUE_GLOBAL_PRIORITY_HIGH_KHR);
+            break;
+        }
+    }
+
+    // Without the extension, global priorities are not requested
+    builder.enable_extension_count = 0;
+    device = vs_device_create( (VkPhysicalDevice)dev, builder, instance );
+    CHECK(device != VK_NULL_HANDLE);
+    vs_device_destroy(device, instance);
+    for(uint32_t i = 0; i < rec->queue_create_info_count; i++)
+    {
+        CHECK(rec->global_priorities[i] == 0);
+    }
+
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Queue assignment report
+
+bool
+test_queue_assignment_report(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev      = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU);
+    dev->queue_families[0].queueCount = 2;
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+
+    VkQueue queues[4];
+    VkQueue present;
+    vs_queue_request requests[4] =
+    {
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queues[0] },
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queues[1] },
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queues[2] },
+        { .required_flags = VK_QUEUE_TRANSFER_BIT, .destination = &queues[3] },
+    };
+    vs_queue_assignment assignments[4];
+    vs_queue_assignment present_assignment;
+
+    VkDevice device = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder)
+        {
+            .queue_request_count    = 4,
+            .queue_requests         = requests,
+            .allow_shared_queues    = true,
+            .request_present_queue  = true,
+            .surface                = (VkSurfaceKHR)(uintptr_t)0x5u,
+            .present_destination    = &present,
+            .out_assignments        = assignments,
+            .out_present_assignment = &present_assignment,
+        },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+
+    // Three graphics requests on two queues : the third one wraps around to the first queue
+    CHECK(assignments[0].family_index == 0 && assignments[0].queue_index == 0);
+    CHECK(assignments[1].family_index == 0 && assignments[1].queue_index == 1);
+    CHECK(assignments[2].family_index == 0 && assignments[2].queue_index == 0);
+    CHECK(assignments[0].shares_with == 2 && assignments[1].shares_with == VS_QUEUE_NOT_SHARED && assignments[2].shares_with == 0);
+    CHECK(queues[0] == queues[2]);
+
+    CHECK(assignments[3].family_index == 2 && assignments[3].shares_with == VS_QUEUE_NOT_SHARED);
+    CHECK(assignments[3].family_flags == dev->queue_families[2].queueFlags);
+    CHECK(assignments[3].timestamp_valid_bits == 64);
+    CHECK(assignments[3].global_priority == 0);
+
+    CHECK(present_assignment.family_index == 0 && present_assignment.queue_index == 0 && present_assignment.shares_with == 0);
+    CHECK(present == queues[0]);
+
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Queue submission
+
+#define _TEST_PRODUCER_COUNT  4
+#define _TEST_PRODUCER_SUBMITS 5000
+
+static vs_queue _test_queue;
+static vs_queue _test_shared_queues[3];
+
+void *
+_test_producer(void *arg)
+{
+    (void)arg;
+    VkSubmitInfo2 submit = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
+    for(uint32_t i = 0; i < _TEST_PRODUCER_SUBMITS; i++)
+    {
+        while( !vs_queue_submit(&_test_queue, &submit, VK_NULL_HANDLE, NULL) )
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+bool
+test_queue_submission(void)
+{
+    vs_mock_reset();
+    VkDevice device = (VkDevice)(uintptr_t)0x1u;
+    CHECK( vs_queue_init(&_test_queue, device, (VkQueue)(uintptr_t)0x2u) );
+
+    // A fence ends the batch
+    VkSubmitInfo2     submit     = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
+    VkFenceCreateInfo fence_info = { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence           fence;
+    uint64_t          tickets[3];
+    CHECK(vkCreateFence(device, &fence_info, NULL, &fence) == VK_SUCCESS);
+    CHECK( vs_queue_submit(&_test_queue, &submit, VK_NULL_HANDLE, &tickets[0]) );
+    CHECK( vs_queue_submit(&_test_queue, &submit, fence, &tickets[1]) );
+    CHECK( vs_queue_submit(&_test_queue, &submit, VK_NULL_HANDLE, &tickets[2]) );
+    CHECK( !vs_queue_is_drained(&_test_queue, tickets[0]) );
+
+    uint32_t drained = 0;
+    CHECK( vs_queue_drain(&_test_queue, &drained) == VK_SUCCESS );
+    CHECK(drained == 3 && vs_queue_is_drained(&_test_queue, tickets[2]) );
+    CHECK(vs_mock_submit_stats_get()->submit_calls == 2 && vs_mock_submit_stats_get()->fenced_submit_calls == 1);
+    CHECK(vkWaitForFences(device, 1, &fence, VK_TRUE, 0) == VK_SUCCESS);
+    vkDestroyFence(device, fence, NULL);
+
+    // A full ring refuses submissions
+    for(uint32_t i = 0; i < VS_QUEUE_RING_SIZE; i++)
+    {
+        CHECK( vs_queue_submit(&_test_queue, &submit, VK_NULL_HANDLE, NULL) );
+    }
+    CHECK( !vs_queue_submit(&_test_queue, &submit, VK_NULL_HANDLE, NULL) );
+    CHECK( vs_queue_drain(&_test_queue, &drained) == VK_SUCCESS && drained == VS_QUEUE_RING_SIZE );
+
+    // Many producers, one consumer
+    vs_mock_reset();
+    pthread_t producers[_TEST_PRODUCER_COUNT];
+    for(uint32_t i = 0; i < _TEST_PRODUCER_COUNT; i++)
+    {
+        pthread_create(&producers[i], NULL, _test_producer, NULL);
+    }
+
+    uint64_t total = 0;
+    while(total < _TEST_PRODUCER_COUNT * _TEST_PRODUCER_SUBMITS)
+    {
+        CHECK( vs_queue_drain(&_test_queue, &drained) == VK_SUCCESS );
+        total += drained;
+    }
+    for(uint32_t i = 0; i < _TEST_PRODUCER_COUNT; i++)
+    {
+        pthread_join(producers[i], NULL);
+    }
+    CHECK(vs_mock_submit_stats_get()->submit_infos == _TEST_PRODUCER_COUNT * _TEST_PRODUCER_SUBMITS);
+    CHECK(vs_mock_submit_stats_get()->submit_calls <= vs_mock_submit_stats_get()->submit_infos);
+
+    // Wrappers of requests sharing a queue forward to the same ring
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    dev->queue_family_count           = 1;
+    dev->queue_families[0].queueCount = 2;
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    vs_queue_request requests[3] =
+    {
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .wrapper = &_test_shared_queues[0] },
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .wrapper = &_test_shared_queues[1] },
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .wrapper = &_test_shared_queues[2] },
+    };
+    VkDevice created = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 3, .queue_requests = requests, .allow_shared_queues = true },
+        instance
+        );
+    CHECK(created != VK_NULL_HANDLE);
+    CHECK(_test_shared_queues[0].target == &_test_shared_queues[0] && _test_shared_queues[1].target == &_test_shared_queues[1]);
+    CHECK(_test_shared_queues[2].target == &_test_shared_queues[0]);
+    CHECK(vs_mock_last_device_creation()->features_13.synchronization2);
+    vs_device_destroy(created, instance);
+
+    // Below Vulkan 1.3 the wrappers need the feature of VK_KHR_synchronization2, which is not enabled implicitly
+    vs_instance old_instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .required_api_version = VK_API_VERSION_1_2 }, &old_instance ) );
+    vs_device_builder old_builder = { .queue_request_count = 1, .queue_requests = requests };
+    CHECK(vs_device_create( (VkPhysicalDevice)dev, old_builder, old_instance ) == VK_NULL_HANDLE);
+    char *synchronization2             = "VK_KHR_synchronization2";
+    old_builder.enable_extension_count = 1;
+    old_builder.enable_extensions      = &synchronization2;
+    created = vs_device_create( (VkPhysicalDevice)dev, old_builder, old_instance );
+    CHECK(created != VK_NULL_HANDLE);
+    CHECK(vs_mock_last_device_creation()->synchronization2 && !vs_mock_last_device_creation()->features_13.synchronization2);
+    vs_device_destroy(created, old_instance);
+    vs_instance_destroy(old_instance);
+
+    // Without vkQueueSubmit2 the wrappers cannot submit, and the device is not created
+    VkQueue             queue      = VK_NULL_HANDLE;
+    vs_queue_assignment assignment = { .family_index = UINT32_MAX };
+    vs_mock_hide_device_command("vkQueueSubmit2");
+    vs_mock_hide_device_command("vkQueueSubmit2KHR");
+    requests[0].destination = &queue;
+    created = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = requests, .out_assignments = &assignment },
+        instance
+        );
+    CHECK(created == VK_NULL_HANDLE && queue == VK_NULL_HANDLE && assignment.family_index == UINT32_MAX);
+
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Dispatch
+
+bool
+test_dispatch(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    CHECK(instance.dispatch.vkCreateDevice == vkCreateDevice && instance.dispatch.vkGetDeviceProcAddr == vkGetDeviceProcAddr);
+    CHECK(instance.dispatch.vkCreateDebugUtilsMessengerEXT != NULL && instance.dispatch.vkGetPhysicalDeviceSurfacePresentModesKHR == NULL);
+
+    vs_device_dispatch dispatch;
+    memset(&dispatch, 0xff, sizeof(dispatch) );
+    VkQueue          queue;
+    vs_queue_request request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+
+    VkDevice device = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_dispatch = &dispatch },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+
+    // Hot path commands skip the trampolines, commands the driver does not expose are NULL
+    CHECK(dispatch.vkQueueSubmit2 != NULL && dispatch.vkQueueSubmit2 != vkQueueSubmit2);
+    CHECK(dispatch.vkCmdDraw != NULL && dispatch.vkCmdDraw != vkCmdDraw);
+    CHECK(dispatch.vkGetDeviceQueue == vkGetDeviceQueue);
+    CHECK(dispatch.vkCmdDispatch == NULL && dispatch.vkCreateSwapchainKHR == NULL);
+
+    VkSubmitInfo2 submit = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
+    CHECK(dispatch.vkQueueSubmit2(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
+    CHECK(vkQueueSubmit2(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
+    CHECK(vs_mock_submit_stats_get()->submit_calls == 2);
+
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Bootstrap
+
+static vs_bootstrap _test_bootstrap;
+
+bool
+test_bootstrap(void)
+{
+    vs_mock_reset();
+    for(uint32_t i = 0; i < 12; i++)
+    {
+        vs_mock_physical_device *dev                = vs_mock_add_physical_device("Mock dGPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+        dev->memory_properties.memoryHeaps[0].size = (4ull + i % 5) << 30;
+    }
+
+    VkQueue          queue   = VK_NULL_HANDLE;
+    vs_queue_request request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    vs_bootstrap_info info   =
+    {
+        .selector           = { .required_queue_count = 1, .required_queues = &request },
+        .device_builder     = { .queue_request_count = 1, .queue_requests = &request },
+        .probe_thread_count = 4,
+    };
+
+    // The probing threads allocate their snapshots with the callbacks of the instance
+    _test_host_allocator  host_allocator = { 0 };
+    VkAllocationCallbacks callbacks      = { .pUserData = &host_allocator, .pfnAllocation = _test_host_allocation, .pfnFree = _test_host_free };
+    info.instance_builder.allocation_callbacks = &callbacks;
+
+    // The first of the devices with the most memory wins, as when probing sequentially
+    CHECK( vs_bootstrap_start(&_test_bootstrap, info) );
+    while(vs_bootstrap_poll(&_test_bootstrap) == VS_BOOTSTRAP_PENDING)
+    {
+        sched_yield();
+    }
+    CHECK(vs_bootstrap_wait(&_test_bootstrap) == VS_BOOTSTRAP_SUCCESS);
+    CHECK(vs_mock_physical_device_get(_test_bootstrap.physical_device)->memory_properties.memoryHeaps[0].size == 8ull << 30);
+    CHECK(vs_select_physical_device(info.selector, _test_bootstrap.instance) == _test_bootstrap.physical_device);
+    CHECK(_test_bootstrap.device != VK_NULL_HANDLE && queue != VK_NULL_HANDLE);
+    CHECK(vs_mock_last_device_creation()->physical_device == _test_bootstrap.physical_device);
+    CHECK(host_allocator.allocations >= 4 && host_allocator.allocations == host_allocator.frees);
+
+    vs_device_destroy(_test_bootstrap.device, _test_bootstrap.instance);
+    vs_instance_destroy(_test_bootstrap.instance);
+
+    // Failures are reported with the stage that failed
+    info.selector.required_features.geometryShader = true;
+    CHECK( vs_bootstrap_start(&_test_bootstrap, info) );
+    CHECK(vs_bootstrap_wait(&_test_bootstrap) == VS_BOOTSTRAP_NO_SUITABLE_DEVICE);
+    CHECK(vs_bootstrap_poll(&_test_bootstrap) == VS_BOOTSTRAP_NO_SUITABLE_DEVICE);
+    return true;
+}
+
+// ## Debug messenger
+
+static vs_debug_messenger _test_messenger;
+static _Atomic uint32_t   _test_sink_count;
+static _Atomic uint32_t   _test_sink_repeats;
+
+void
+_test_sink(const vs_debug_message *message, void *udata)
+{
+    (void)udata;
+    _test_sink_count++;
+    _test_sink_repeats += message->repeat_count;
+}
+
+bool
+test_debug_messenger(void)
+{
+    vs_mock_reset();
+    vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    vs_debug_messenger_init(&_test_messenger, (vs_debug_messenger_info){ .max_repeats = 2, .window_ms = 100, .sink = _test_sink });
+    _test_sink_count   = 0;
+    _test_sink_repeats = 0;
+
+    // Only warnings and errors by default
+    vs_instance instance;
+    CHECK( vs_instance_builder_build(
+               (vs_instance_builder)
+               {
+                   .request_validation_layers       = true,
+                   .validation_layers_message_types = VS_DEBUG_UTILS_MESSAGE_TYPE_ALL,
+                   .messenger_callback              = vs_debug_messenger_callback,
+                   .messenger_user_data             = &_test_messenger,
+               },
+               &instance) );
+    CHECK(instance.messenger_created);
+    CHECK(vs_mock_debug_messenger_get()->severities == (VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) );
+    CHECK( !vs_mock_emit_debug_message(VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT, 1, "info") );
+
+    // Repeats of an id past `max_repeats` are only counted
+    for(uint32_t i = 0; i < 5; i++)
+    {
+        CHECK( vs_mock_emit_debug_message(VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT, 7, "repeated") );
+    }
+    CHECK( vs_mock_emit_debug_message(VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT, -3, "other") );
+    CHECK(vs_debug_messenger_drain(&_test_messenger) == 3);
+    vs_debug_messenger_stats stats = vs_debug_messenger_stats_get(&_test_messenger);
+    CHECK(stats.pushed == 3 && stats.delivered == 3 && stats.suppressed == 3 && stats.dropped == 0);
+
+    // A full ring drops messages instead of blocking
+    for(uint32_t i = 0; i < VS_DEBUG_MESSENGER_RING_SIZE + 10; i++)
+    {
+        vs_mock_emit_debug_message(VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT, 1000 + (int32_t)i, "distinct");
+    }
+    CHECK(vs_debug_messenger_stats_get(&_test_messenger).dropped == 10);
+    CHECK(vs_debug_messenger_drain(&_test_messenger) == VS_DEBUG_MESSENGER_RING_SIZE);
+    vs_instance_destroy(instance);
+
+    // The severity mask is given to the messenger, and a background thread drains it
+    CHECK( vs_instance_builder_build(
+               (vs_instance_builder)
+               {
+                   .request_validation_layers            = true,
+                   .validation_layers_message_severities = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
+                   .messenger_callback                   = vs_debug_messenger_callback,
+                   .messenger_user_data                  = &_test_messenger,
+               },
+               &instance) );
+    CHECK(vs_mock_debug_messenger_get()->severities == VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT);
+    CHECK( vs_debug_messenger_start(&_test_messenger) );
+
+    // Once the window is over, the suppressed repeats are reported with the next message of their id
+    usleep(150 * 1000);
+    uint32_t delivered = _test_sink_count;
+    CHECK( vs_mock_emit_debug_message(VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT, 7, "repeated") );
+    for(uint32_t i = 0; i < 1000 && _test_sink_count == delivered; i++)
+    {
+        usleep(1000);
+    }
+    CHECK(_test_sink_count == delivered + 1);
+    CHECK(_test_sink_repeats == 3);
+    vs_instance_destroy(instance);
+    vs_debug_messenger_stop(&_test_messenger);
+    return true;
+}
+
+// ## Validation profiles
+
+/**
+ * @brief Gets a boolean layer setting recorded by the mock, -1 if it was not set
+ */
+int
+_test_layer_setting(const char *name)
+{
+    const vs_mock_instance_creation *creation = vs_mock_last_instance_creation();
+    for(uint32_t i = 0; i < creation->layer_setting_count; i++)
+    {
+        if(strcmp(creation->layer_settings[i], name) == 0)
+        {
+            return (int)creation->layer_setting_values[i];
+        }
+    }
+    return -1;
+}
+
+bool
+test_validation_profiles(void)
+{
+    vs_mock_reset();
+    vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_validation_profile profile = VS_VALIDATION_PROFILE_DEFAULT;
+    CHECK( vs_validation_profile_from_name("gpu-assisted", &profile) && profile == VS_VALIDATION_PROFILE_GPU_ASSISTED );
+    CHECK( !vs_validation_profile_from_name("slow", &profile) && profile == VS_VALIDATION_PROFILE_GPU_ASSISTED );
+    CHECK( !vs_validation_profile_from_name(NULL, &profile) );
+
+    // Default : the layer configuration is left untouched
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .request_validation_layers = true }, &instance ) );
+    const vs_mock_instance_creation *creation = vs_mock_last_instance_creation();
+    CHECK(creation->enabled_layer_count == 1 && creation->enabled_extension_count == 1);
+    CHECK(creation->layer_setting_count == 0 && creation->validation_disable_count == 0);
+    vs_instance_destroy(instance);
+
+    // Through the layer settings
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .request_validation_layers = true, .validation_profile = VS_VALIDATION_PROFILE_FAST }, &instance ) );
+    CHECK(creation->enabled_extension_count == 2 && strcmp(creation->enabled_extensions[1], "VK_EXT_layer_settings") == 0);
+    CHECK(_test_layer_setting("validate_core") == VK_TRUE);
+    CHECK(_test_layer_setting("thread_safety") == VK_FALSE && _test_layer_setting("object_lifetime") == VK_FALSE);
+    CHECK(creation->validation_disable_count == 0);
+    vs_instance_destroy(instance);
+
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .request_validation_layers = true, .validation_profile = VS_VALIDATION_PROFILE_SYNC }, &instance ) );
+    CHECK(_test_layer_setting("validate_sync") == VK_TRUE && _test_layer_setting("thread_safety") == VK_TRUE);
+    vs_instance_destroy(instance);
+
+    // Older layers only have the validation features
+    vs_mock_set_legacy_validation_layer(true);
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .request_validation_layers = true, .validation_profile = VS_VALIDATION_PROFILE_FAST }, &instance ) );
+    CHECK(strcmp(creation->enabled_extensions[1], "VK_EXT_validation_features") == 0 && creation->layer_setting_count == 0);
+    CHECK(creation->validation_disable_count == 2 && creation->validation_enable_count == 0);
+    CHECK(creation->validation_disables[0] == VK_VALIDATION_FEATURE_DISABLE_THREAD_SAFETY_EXT);
+    vs_instance_destroy(instance);
+
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .request_validation_layers = true, .validation_profile = VS_VALIDATION_PROFILE_BEST_PRACTICES }, &instance ) );
+    CHECK(creation->validation_enable_count == 1 && creation->validation_enables[0] == VK_VALIDATION_FEATURE_ENABLE_BEST_PRACTICES_EXT);
+    vs_instance_destroy(instance);
+
+    // Without validation layers, the profile is ignored
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .validation_profile = VS_VALIDATION_PROFILE_FAST }, &instance ) );
+    CHECK(creation->enabled_layer_count == 0 && creation->enabled_extension_count == 0);
+    vs_instance_destroy(instance);
+
+    // Unknown profiles are refused, as by name
+    CHECK( !vs_instance_builder_build( (vs_instance_builder){ .request_validation_layers = true, .validation_profile = (vs_validation_profile)42 }, &instance ) );
+    return true;
+}
+
+// ## Format table
+
+bool
+test_format_table(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev             = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    VkPhysicalDevice         physical_device = (VkPhysicalDevice)dev;
+
+    // Vulkan 1.0 without extensions : only the core formats, through the legacy query
+    vs_format_table *table = malloc( sizeof(vs_format_table) );
+    vs_format_table_build(physical_device, VK_API_VERSION_1_0, 0, NULL, table);
+    CHECK(!table->features2 && table->format_count == 184);
+    CHECK(dev->calls.get_format_properties == 184 && dev->calls.get_format_properties2 == 0);
+    CHECK(vs_format_table_get(table, VK_FORMAT_R8G8B8A8_UNORM) != NULL);
+    CHECK(vs_format_table_get(table, VK_FORMAT_A4R4G4B4_UNORM_PACK16) == NULL);
+    CHECK(vs_format_table_get(table, VK_FORMAT_UNDEFINED) == NULL);
+
+    VkFormat        storage_formats[] = { VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM };
+    vs_format_set   storage_set       = { .format_count = 2, .formats = storage_formats };
+    vs_format_query storage           = { .required_optimal_tiling_features = VK_FORMAT_FEATURE_2_STORAGE_WRITE_WITHOUT_FORMAT_BIT };
+    CHECK(vs_format_table_query_format(table, storage, storage_set) == VK_FORMAT_UNDEFINED);
+
+    // Vulkan 1.3 : the 64 bit features are known, and each format is queried once
+    dev->calls.get_format_properties = 0;
+    vs_format_table_build(physical_device, VK_API_VERSION_1_3, 0, NULL, table);
+    CHECK(table->features2 && table->format_count == 238);
+    CHECK(dev->calls.get_format_properties == 0 && dev->calls.get_format_properties2 == 238);
+    CHECK(vs_format_table_get(table, VK_FORMAT_A4R4G4B4_UNORM_PACK16) != NULL);
+    CHECK(vs_format_table_get(table, VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG) == NULL);
+
+    // Queries never reach the driver
+    dev->calls.get_format_properties2 = 0;
+    CHECK(vs_format_table_query_format(table, storage, storage_set) == VK_FORMAT_R8G8B8A8_UNORM);
+
+    uint32_t        count   = 0;
+    vs_format_query sampled = { .required_optimal_tiling_features = VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_BIT };
+    vs_format_table_query_formats(table, sampled, (vs_format_set){ 0 }, &count, NULL);
+    CHECK(count == table->format_count);
+    vs_format_table_query_formats(table, storage, (vs_format_set){ 0 }, &count, NULL);
+    CHECK(count > 0 && count < table->format_count);
+
+    vs_format_query queries[] =
+    {
+        storage,
+        sampled,
+        { .required_buffer_features = VK_FORMAT_FEATURE_2_STORAGE_READ_WITHOUT_FORMAT_BIT },
+        { .required_linear_tiling_features = VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_DEPTH_COMPARISON_BIT },
+    };
+    VkFormat results[4];
+    CHECK(vs_format_table_query_batch(table, 4, queries, storage_set, results) == 3);
+    CHECK(results[0] == VK_FORMAT_R8G8B8A8_UNORM && results[1] == VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+    CHECK(results[2] == VK_FORMAT_R8G8B8A8_UNORM && results[3] == VK_FORMAT_UNDEFINED);
+    CHECK(vs_format_table_query_batch(table, 4, queries, (vs_format_set){ 0 }, results) == 3);
+    CHECK(results[1] == table->formats[0]);
+    CHECK(dev->calls.get_format_properties == 0 && dev->calls.get_format_properties2 == 0);
+
+    // Extension formats only once their extension is enabled
+    char *extensions[] = { "VK_KHR_format_feature_flags2", "VK_IMG_format_pvrtc" };
+    vs_format_table_build(physical_device, VK_API_VERSION_1_0, 2, extensions, table);
+    CHECK(table->features2 && table->format_count == 192);
+    CHECK(vs_format_table_get(table, VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG) != NULL);
+    CHECK(vs_format_table_get(table, VK_FORMAT_G8B8G8R8_422_UNORM) == NULL);
+
+    free(table);
+    return true;
+}
+
+bool
+test_image_formats(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev             = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    VkPhysicalDevice         physical_device = (VkPhysicalDevice)dev;
+
+    for(uint32_t kind = 0; kind < VS_FORMAT_SET_COUNT; kind++)
+    {
+        CHECK(vs_format_set_get(kind).format_count > 0);
+    }
+    CHECK(vs_format_set_get(VS_FORMAT_SET_COMPRESSED_ASTC).formats[0] == VK_FORMAT_ASTC_4x4_UNORM_BLOCK);
+
+    vs_image_format_cache *cache = malloc( sizeof(vs_image_format_cache) );
+    vs_image_format_cache_init(cache, physical_device, NULL);
+
+    // The most compact format that works
+    vs_image_format_query depth =
+    {
+        .image_type       = VK_IMAGE_TYPE_2D,
+        .tiling           = VK_IMAGE_TILING_OPTIMAL,
+        .usage            = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .required_samples = VK_SAMPLE_COUNT_4_BIT,
+        .min_extent       = { 3840, 2160, 1 },
+    };
+    CHECK(vs_image_format_query_format(cache, depth, vs_format_set_get(VS_FORMAT_SET_DEPTH) ) == VK_FORMAT_D16_UNORM);
+    CHECK(dev->calls.get_image_format_properties == 1);
+
+    // The limits of the image rule out formats
+    dev->image_format_override             = VK_FORMAT_D16_UNORM;
+    dev->image_format_override_properties  = (VkImageFormatProperties){ .maxExtent = { 4096, 4096, 1 }, .maxMipLevels = 1, .maxArrayLayers = 1, .sampleCounts = VK_SAMPLE_COUNT_1_BIT };
+    dev->calls.get_image_format_properties = 0;
+    vs_image_format_cache_init(cache, physical_device, NULL);
+    CHECK(vs_image_format_query_format(cache, depth, vs_format_set_get(VS_FORMAT_SET_DEPTH) ) == VK_FORMAT_X8_D24_UNORM_PACK32);
+    depth.required_samples = 0;
+    depth.min_extent       = (VkExtent3D){ 8192, 8192, 1 };
+    CHECK(vs_image_format_query_format(cache, depth, vs_format_set_get(VS_FORMAT_SET_DEPTH) ) == VK_FORMAT_X8_D24_UNORM_PACK32);
+    depth.min_extent       = (VkExtent3D){ 1024, 1024, 1 };
+    CHECK(vs_image_format_query_format(cache, depth, vs_format_set_get(VS_FORMAT_SET_DEPTH) ) == VK_FORMAT_D16_UNORM);
+
+    // Results are cached, only the unknown image parameters reach the driver
+    CHECK(dev->calls.get_image_format_properties == 2 && cache->entry_count == 2);
+
+    // Unsupported usages and image types
+    vs_image_format_query volume = { .image_type = VK_IMAGE_TYPE_3D, .tiling = VK_IMAGE_TILING_OPTIMAL, .usage = VK_IMAGE_USAGE_SAMPLED_BIT };
+    CHECK(vs_image_format_query_format(cache, volume, vs_format_set_get(VS_FORMAT_SET_DEPTH) ) == VK_FORMAT_UNDEFINED);
+    vs_image_format_query storage = { .image_type = VK_IMAGE_TYPE_2D, .tiling = VK_IMAGE_TILING_OPTIMAL, .usage = VK_IMAGE_USAGE_STORAGE_BIT };
+    CHECK(vs_image_format_query_format(cache, storage, vs_format_set_get(VS_FORMAT_SET_COMPRESSED) ) == VK_FORMAT_UNDEFINED);
+    CHECK(vs_image_format_query_format(cache, storage, vs_format_set_get(VS_FORMAT_SET_HDR_COLOR) ) == VK_FORMAT_B10G11R11_UFLOAT_PACK32);
+    uint32_t calls = dev->calls.get_image_format_properties;
+    CHECK(vs_image_format_query_format(cache, storage, vs_format_set_get(VS_FORMAT_SET_COMPRESSED) ) == VK_FORMAT_UNDEFINED);
+    CHECK(dev->calls.get_image_format_properties == calls);
+
+    // With a format table, formats missing the features are skipped without calling Vulkan
+    vs_format_table *table = malloc( sizeof(vs_format_table) );
+    vs_format_table_build(physical_device, VK_API_VERSION_1_3, 0, NULL, table);
+    vs_image_format_cache_init(cache, physical_device, table);
+    dev->calls.get_format_properties       = 0;
+    dev->calls.get_format_properties2      = 0;
+    dev->calls.get_image_format_properties = 0;
+    vs_image_format_query color =
+    {
+        .image_type        = VK_IMAGE_TYPE_2D,
+        .tiling            = VK_IMAGE_TILING_OPTIMAL,
+        .usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .required_features = VK_FORMAT_FEATURE_2_COLOR_ATTACHMENT_BIT,
+    };
+    CHECK(vs_image_format_query_format(cache, color, vs_format_set_get(VS_FORMAT_SET_DEPTH) ) == VK_FORMAT_UNDEFINED);
+    CHECK(vs_image_format_query_format(cache, color, vs_format_set_get(VS_FORMAT_SET_COLOR) ) == VK_FORMAT_R8G8B8A8_UNORM);
+    CHECK(dev->calls.get_image_format_properties == 1);
+    CHECK(dev->calls.get_format_properties == 0 && dev->calls.get_format_properties2 == 0);
+
+    free(table);
+    free(cache);
+    return true;
+}
+
+// ## Memory policy
+
+/**
+ * @brief Gets the memory type a policy picks for a usage, -1 if none
+ */
+int
+_test_memory_type(const vs_memory_policy *policy, vs_memory_usage usage)
+{
+    uint32_t type = 0;
+    return vs_memory_policy_find_type(policy, usage, ~0u, 0, &type) ? (int)type : -1;
+}
+
+bool
+test_memory_policy(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    VkPhysicalDeviceMemoryProperties *props = &dev->memory_properties;
+    vs_memory_policy policy;
+
+    // Discrete device : device local memory and system memory
+    vs_memory_policy_build( (VkPhysicalDevice)dev, NULL, false, &policy );
+    CHECK(!policy.rebar && !policy.uma);
+    CHECK(_test_memory_type(&policy, VS_MEMORY_USAGE_GPU_ONLY) == 0 && _test_memory_type(&policy, VS_MEMORY_USAGE_TRANSIENT) == 0);
+    CHECK(_test_memory_type(&policy, VS_MEMORY_USAGE_UPLOAD) == 1 && _test_memory_type(&policy, VS_MEMORY_USAGE_STAGING) == 1);
+    CHECK(_test_memory_type(&policy, VS_MEMORY_USAGE_READBACK) == 1);
+    uint32_t type = 42;
+    CHECK(!vs_memory_policy_find_type(&policy, VS_MEMORY_USAGE_UPLOAD, 0x1, 0, &type) && type == 42);
+
+    // A 256 MiB BAR is left alone, readbacks go to cached memory
+    props->memoryHeapCount = 3;
+    props->memoryHeaps[2]  = (VkMemoryHeap){ .size = 256ull << 20, .flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+    props->memoryTypeCount = 4;
+    props->memoryTypes[2]  = (VkMemoryType){ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 2 };
+    props->memoryTypes[3]  = (VkMemoryType){ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1 };
+    vs_memory_policy_build( (VkPhysicalDevice)dev, NULL, false, &policy );
+    CHECK(!policy.rebar && !policy.uma);
+    CHECK(_test_memory_type(&policy, VS_MEMORY_USAGE_UPLOAD) == 1 && _test_memory_type(&policy, VS_MEMORY_USAGE_READBACK) == 3);
+    CHECK(vs_memory_policy_find_type(&policy, VS_MEMORY_USAGE_UPLOAD, 0x4, 0, &type) && type == 2);
+
+    // Resizable BAR : uploads go straight to device local memory
+    props->memoryTypes[2].heapIndex = 0;
+    vs_memory_policy_build( (VkPhysicalDevice)dev, NULL, false, &policy );
+    CHECK(policy.rebar);
+    CHECK(_test_memory_type(&policy, VS_MEMORY_USAGE_UPLOAD) == 2 && _test_memory_type(&policy, VS_MEMORY_USAGE_GPU_ONLY) == 0);
+    CHECK(_test_memory_type(&policy, VS_MEMORY_USAGE_STAGING) == 1);
+
+    // UMA : a single device local heap
+    props->memoryHeapCount = 1;
+    props->memoryTypeCount = 4;
+    props->memoryTypes[0]  = (VkMemoryType){ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+    props->memoryTypes[1]  = (VkMemoryType){ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0 };
+    props->memoryTypes[2]  = (VkMemoryType){ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 0 };
+    props->memoryTypes[3]  = (VkMemoryType){ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, 0 };
+    vs_memory_policy_build( (VkPhysicalDevice)dev, NULL, false, &policy );
+    CHECK(policy.uma && !policy.rebar);
+    CHECK(_test_memory_type(&policy, VS_MEMORY_USAGE_GPU_ONLY) == 0 && _test_memory_type(&policy, VS_MEMORY_USAGE_UPLOAD) == 1);
+    CHECK(_test_memory_type(&policy, VS_MEMORY_USAGE_READBACK) == 2 && _test_memory_type(&policy, VS_MEMORY_USAGE_TRANSIENT) == 3);
+    CHECK(policy.type_counts[VS_MEMORY_USAGE_GPU_ONLY] == 3);
+
+    // Built along with the device, with the budgets of VK_EXT_memory_budget
+    vs_mock_reset();
+    dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    dev->heap_usages[0] = 7ull << 30;
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    VkQueue          queue;
+    vs_queue_request request      = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    char            *extensions[] = { "VK_EXT_memory_budget" };
+    VkDevice         device       = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .enable_extension_count = 1, .enable_extensions = extensions, .out_memory_policy = &policy },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+    CHECK(policy.memory_budget && dev->calls.get_memory_properties2 == 1);
+    CHECK(policy.heap_budgets[0] == 8ull << 30 && policy.heap_usages[0] == 7ull << 30);
+    CHECK(vs_memory_policy_find_type(&policy, VS_MEMORY_USAGE_GPU_ONLY, ~0u, 512ull << 20, &type) && type == 0);
+    CHECK(!vs_memory_policy_find_type(&policy, VS_MEMORY_USAGE_GPU_ONLY, ~0u, 2ull << 30, &type) );
+
+    dev->heap_usages[0] = 0;
+    vs_memory_policy_update_budget(&policy);
+    CHECK(vs_memory_policy_find_type(&policy, VS_MEMORY_USAGE_GPU_ONLY, ~0u, 2ull << 30, &type) );
+
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Memory arena
+
+bool
+test_memory_arena(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    VkQueue          queue;
+    vs_queue_request request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    vs_memory_arena  arena;
+    VkDevice         device  = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_memory_arena = &arena },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+    CHECK(arena.info.buffer_image_granularity == 1024 && arena.info.dedicated_allocation);
+    const vs_mock_memory_stats *mem = vs_mock_memory_stats_get();
+
+    // Many sub-allocations share a single block, aligned and without overlap
+    vs_memory_allocation allocations[256];
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        vs_memory_request req =
+        {
+            .requirements = { .size = 100 + i * 37, .alignment = 1u << (i % 9), .memoryTypeBits = ~0u },
+            .usage        = VS_MEMORY_USAGE_GPU_ONLY,
+        };
+        CHECK(vs_memory_arena_allocate(&arena, &req, &allocations[i]) );
+        CHECK(allocations[i].offset % req.requirements.alignment == 0 && allocations[i].type_index == 0);
+        CHECK(allocations[i].memory == allocations[0].memory && allocations[i].mapped == NULL);
+        for(uint32_t j = 0; j < i; j++)
+        {
+            CHECK(allocations[i].offset + allocations[i].size <= allocations[j].offset ||
+                  allocations[j].offset + allocations[j].size <= allocations[i].offset);
+        }
+    }
+    CHECK(mem->allocate_calls == 1 && mem->live_bytes == VS_MEMORY_ARENA_BLOCK_SIZE);
+
+    // Freeing every other allocation leaves holes, freeing the rest coalesces them
+    vs_memory_arena_stats stats;
+    for(uint32_t i = 0; i < 256; i += 2)
+    {
+        vs_memory_arena_free(&arena, &allocations[i]);
+    }
+    CHECK(allocations[0].memory == VK_NULL_HANDLE);
+    vs_memory_arena_stats_get(&arena, &stats);
+    CHECK(stats.allocation_count == 128 && stats.free_range_count > 100);
+    for(uint32_t i = 1; i < 256; i += 2)
+    {
+        vs_memory_arena_free(&arena, &allocations[i]);
+    }
+    vs_memory_arena_stats_get(&arena, &stats);
+    CHECK(stats.allocation_count == 0 && stats.used_bytes == 0 && stats.block_count == 1);
+    CHECK(stats.free_range_count == 1 && stats.largest_free_range == VS_MEMORY_ARENA_BLOCK_SIZE);
+    CHECK(stats.total_allocations == 256 && stats.total_frees == 256);
+
+    // Optimal images do not share the blocks of linear resources, which are kept mapped when host visible
+    vs_memory_request buffer_req = { .requirements = { .size = 4096, .alignment = 16, .memoryTypeBits = ~0u }, .usage = VS_MEMORY_USAGE_GPU_ONLY };
+    vs_memory_request image_req  = { .requirements = { .size = 4096, .alignment = 16, .memoryTypeBits = ~0u }, .usage = VS_MEMORY_USAGE_GPU_ONLY, .optimal_image = true };
+    vs_memory_request upload_req = { .requirements = { .size = 4096, .alignment = 16, .memoryTypeBits = ~0u }, .usage = VS_MEMORY_USAGE_UPLOAD };
+    vs_memory_allocation buffer, image, upload;
+    CHECK(vs_memory_arena_allocate(&arena, &buffer_req, &buffer) && vs_memory_arena_allocate(&arena, &image_req, &image) );
+    CHECK(buffer.memory != image.memory && mem->allocate_calls == 2);
+    CHECK(vs_memory_arena_allocate(&arena, &upload_req, &upload) && upload.type_index == 1 && upload.mapped != NULL);
+    memset(upload.mapped, 0xAB, 4096);
+
+    // Dedicated allocations, when preferred by the driver or too large for a block
+    vs_memory_request dedicated_req = image_req;
+    dedicated_req.prefers_dedicated = true;
+    dedicated_req.dedicated_image   = (VkImage)(uintptr_t)0x1234;
+    vs_memory_request large_req     = buffer_req;
+    large_req.requirements.size     = VS_MEMORY_ARENA_BLOCK_SIZE;
+    vs_memory_allocation dedicated, large;
+    CHECK(vs_memory_arena_allocate(&arena, &dedicated_req, &dedicated) && dedicated.dedicated && dedicated.offset == 0);
+    CHECK(vs_memory_arena_allocate(&arena, &large_req, &large) && large.dedicated);
+    CHECK(mem->dedicated_allocations == 1 && mem->live_allocations == 5);
+    vs_memory_arena_stats_get(&arena, &stats);
+    CHECK(stats.dedicated_count == 2 && stats.block_count == 3);
+    vs_memory_arena_free(&arena, &dedicated);
+    vs_memory_arena_free(&arena, &large);
+    CHECK(mem->live_allocations == 3);
+
+    // Types outside of the memory type bits are never used, even if the usage cannot be served otherwise
+    vs_memory_request device_only_req = upload_req;
+    device_only_req.requirements.memoryTypeBits = 0x1;
+    vs_memory_allocation refused;
+    CHECK(!vs_memory_arena_allocate(&arena, &device_only_req, &refused) );
+
+    // Linear allocators, bump and ring
+    vs_memory_linear linear;
+    vs_memory_allocation range;
+    CHECK(vs_memory_linear_init(&arena, VS_MEMORY_USAGE_UPLOAD, 1024, false, &linear) );
+    CHECK(vs_memory_linear_allocate(&linear, 100, 1, &range) && range.offset == linear.allocation.offset);
+    CHECK(vs_memory_linear_allocate(&linear, 100, 64, &range) && range.offset % 64 == 0 && range.mapped != NULL);
+    CHECK(!vs_memory_linear_allocate(&linear, 1024, 1, &range) );
+    vs_memory_linear_reset(&linear);
+    CHECK(vs_memory_linear_allocate(&linear, 1024, 1, &range) );
+    vs_memory_linear_destroy(&arena, &linear);
+
+    CHECK(vs_memory_linear_init(&arena, VS_MEMORY_USAGE_UPLOAD, 1024, true, &linear) );
+    CHECK(vs_memory_linear_allocate(&linear, 400, 1, &range) );
+    uint64_t first = vs_memory_linear_mark(&linear);
+    CHECK(vs_memory_linear_allocate(&linear, 400, 1, &range) );
+    uint64_t second = vs_memory_linear_mark(&linear);
+    CHECK(!vs_memory_linear_allocate(&linear, 400, 1, &range) );
+    // Once the first range is retired, the ring wraps to its start instead of splitting a range
+    vs_memory_linear_release(&linear, first);
+    CHECK(vs_memory_linear_allocate(&linear, 400, 1, &range) && range.offset == linear.allocation.offset);
+    CHECK(!vs_memory_linear_allocate(&linear, 400, 1, &range) );
+    vs_memory_linear_release(&linear, second);
+    CHECK(vs_memory_linear_allocate(&linear, 400, 1, &range) && range.offset == linear.allocation.offset + 400);
+    vs_memory_linear_destroy(&arena, &linear);
+
+    vs_memory_arena_free(&arena, &buffer);
+    vs_memory_arena_free(&arena, &image);
+    vs_memory_arena_free(&arena, &upload);
+    vs_memory_arena_destroy(&arena);
+    CHECK(mem->live_allocations == 0);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+
+    // A 1.3 device behind a 1.0 instance does not provide the 1.1 dedicated allocations
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .required_api_version = VK_API_VERSION_1_0 }, &instance ) );
+    device = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_memory_arena = &arena },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE && !arena.info.dedicated_allocation);
+    vs_memory_arena_destroy(&arena);
+    vs_device_destroy(device, instance);
+
+    // Bookkeeping goes through the allocation callbacks
+    _test_host_allocator  host_allocator = { 0 };
+    VkAllocationCallbacks callbacks      =
+    {
+        .pUserData    = &host_allocator,
+        .pfnAllocation = _test_host_allocation,
+        .pfnFree      = _test_host_free,
+    };
+    vs_memory_policy policy;
+    vs_memory_policy_build( (VkPhysicalDevice)dev, NULL, false, &policy );
+    vs_memory_arena_init(&arena, device, &policy, &callbacks, (vs_memory_arena_info){ .block_size = 1 << 20 });
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        CHECK(vs_memory_arena_allocate(&arena, &buffer_req, &allocations[i]) );
+    }
+    CHECK(mem->allocate_calls - mem->free_calls == 2 && host_allocator.allocations > 2);
+    vs_memory_arena_destroy(&arena);
+    CHECK(host_allocator.allocations == host_allocator.frees && mem->live_allocations == 0);
+
+    // A fresh block too small for the request once rounded to its size class is released, not kept empty
+    VkDeviceSize odd_size = (1 << 20) + 4096;
+    vs_memory_arena_init(&arena, device, &policy, NULL, (vs_memory_arena_info){ .block_size = odd_size, .dedicated_threshold = odd_size + 1 });
+    vs_memory_request unfit_req = { .requirements = { .size = odd_size, .alignment = 1, .memoryTypeBits = 0x1 }, .usage = VS_MEMORY_USAGE_GPU_ONLY };
+    CHECK(!vs_memory_arena_allocate(&arena, &unfit_req, &refused) );
+    vs_memory_arena_stats_get(&arena, &stats);
+    CHECK(stats.block_count == 0 && mem->live_allocations == 0);
+    vs_memory_arena_destroy(&arena);
+
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Memory defragmentation
+
+void
+_test_relocate(const vs_memory_relocation *relocation, void *user_data)
+{
+    ( *(uint32_t *)user_data )++;
+    *(vs_memory_allocation *)relocation->user_data = relocation->allocation;
+}
+
+bool
+test_memory_defrag(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    VkQueue             graphics_queue, transfer_queue;
+    vs_queue_assignment assignments[2];
+    vs_queue_request    requests[] =
+    {
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &graphics_queue },
+        { .required_flags = VK_QUEUE_TRANSFER_BIT, .destination = &transfer_queue },
+    };
+    vs_memory_policy policy;
+    VkDevice         device = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 2, .queue_requests = requests, .out_assignments = assignments, .out_memory_policy = &policy },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+
+    // Two blocks of 31 ranges (a range must be larger than 32 KiB to be found in a 32 KiB free range), the second one
+    // sparse
+    vs_memory_arena arena;
+    vs_memory_arena_init(&arena, device, &policy, NULL, (vs_memory_arena_info){ .block_size = 1 << 20 });
+    vs_memory_allocation allocations[62];
+    vs_memory_allocation pinned;
+    for(uint32_t i = 0; i < 62; i++)
+    {
+        vs_memory_request request =
+        {
+            .requirements = { .size = 32 << 10, .alignment = 256, .memoryTypeBits = ~0u },
+            .usage        = VS_MEMORY_USAGE_UPLOAD,
+            .movable      = true,
+            .user_data    = &allocations[i],
+        };
+        CHECK(vs_memory_arena_allocate(&arena, &request, &allocations[i]) );
+        memset(allocations[i].mapped, (int)i, 32 << 10);
+    }
+    vs_memory_allocation *dense  = allocations;
+    vs_memory_allocation *sparse = &allocations[31];
+    CHECK(dense[30].block == dense[0].block && sparse[0].block != dense[0].block && sparse[30].block == sparse[0].block);
+    for(uint32_t i = 0; i < 27; i++)
+    {
+        vs_memory_arena_free(&arena, &sparse[i]);
+    }
+    for(uint32_t i = 0; i < 8; i++)
+    {
+        vs_memory_arena_free(&arena, &dense[i]);
+    }
+
+    uint32_t         relocations = 0;
+    vs_memory_defrag defrag;
+    CHECK(vs_memory_defrag_init(&defrag, &arena, transfer_queue, assignments[1].family_index,
+                                (vs_memory_defrag_info){ .max_bytes_per_step = 64 << 10, .release_delay = 1, .relocation_callback = _test_relocate, .user_data = &relocations }));
+    const vs_mock_memory_stats *mem = vs_mock_memory_stats_get();
+
+    // The copies of a step stay within the budget, and relocations wait for their completion
+    vs_mock_set_gpu_paused(true);
+    CHECK(vs_memory_defrag_step(&defrag) && mem->copy_regions == 2 && mem->copied_bytes == 64 << 10);
+    CHECK(vs_memory_defrag_step(&defrag) && relocations == 0 && defrag.stats.passes == 1);
+
+    // Freeing an allocation being moved cancels its move
+    VkDeviceMemory sparse_memory = sparse[27].memory;
+    vs_memory_arena_free(&arena, &sparse[27]);
+    vs_mock_set_gpu_paused(false);
+    CHECK(vs_memory_defrag_step(&defrag) && relocations == 1 && defrag.stats.cancelled_moves == 1);
+    CHECK(sparse[28].memory == dense[8].memory && sparse[28].offset % 256 == 0);
+    CHECK( ( (uint8_t *)sparse[28].mapped )[0] == 31 + 28 );
+
+    // The old ranges are released after the delay, then the next pass moves the rest and frees the block
+    CHECK(vs_memory_defrag_step(&defrag) && defrag.stats.passes == 2);
+    vs_memory_allocation old_handle = sparse[30];
+    CHECK(vs_memory_defrag_step(&defrag) && relocations == 3);
+
+    // Freeing the old handle during the release delay, instead of the new one, gives the new range back too
+    vs_memory_arena_free(&arena, &old_handle);
+    sparse[30] = (vs_memory_allocation){ 0 };
+    vs_memory_arena_stats stats;
+    vs_memory_arena_stats_get(&arena, &stats);
+    CHECK(stats.block_count == 2 && defrag.stats.cancelled_moves == 2);
+    CHECK(!vs_memory_defrag_step(&defrag) );
+    vs_memory_arena_stats_get(&arena, &stats);
+    CHECK(stats.block_count == 1 && stats.allocation_count == 25 && stats.used_bytes == 25 * (32 << 10) && mem->live_allocations == 1);
+    CHECK(defrag.stats.blocks_freed == 1 && defrag.stats.allocations_moved == 3 && defrag.stats.bytes_moved == 96 << 10);
+    for(uint32_t i = 28; i < 30; i++)
+    {
+        CHECK(sparse[i].memory != sparse_memory && ( (uint8_t *)sparse[i].mapped )[(32 << 10) - 1] == 31 + i);
+    }
+
+    // Blocks holding allocations that cannot move are left alone
+    vs_memory_request request = { .requirements = { .size = 32 << 10, .alignment = 256, .memoryTypeBits = ~0u }, .usage = VS_MEMORY_USAGE_UPLOAD };
+    for(uint32_t i = 0; i < 16; i++)
+    {
+        CHECK(vs_memory_arena_allocate(&arena, &request, &pinned) );
+    }
+    vs_memory_arena_stats_get(&arena, &stats);
+    CHECK(stats.block_count == 2 && pinned.block != dense[8].block);
+    CHECK(!vs_memory_defrag_step(&defrag) && defrag.stats.passes == 2);
+
+    vs_memory_defrag_destroy(&defrag);
+    CHECK(arena.defrag == NULL);
+    vs_memory_arena_destroy(&arena);
+
+    // Through the wrapper of a shared queue, relocations wait for the wrapper to submit the copies
+    vs_queue wrapper;
+    CHECK( vs_queue_init(&wrapper, device, transfer_queue) );
+    vs_memory_arena_init(&arena, device, &policy, NULL, (vs_memory_arena_info){ .block_size = 1 << 20 });
+    for(uint32_t i = 0; i < 32; i++)
+    {
+        vs_memory_request request =
+        {
+            .requirements = { .size = 32 << 10, .alignment = 256, .memoryTypeBits = ~0u },
+            .usage        = VS_MEMORY_USAGE_UPLOAD,
+            .movable      = true,
+            .user_data    = &allocations[i],
+        };
+        CHECK(vs_memory_arena_allocate(&arena, &request, &allocations[i]) );
+    }
+    CHECK(allocations[31].block != allocations[0].block);
+    vs_memory_arena_free(&arena, &allocations[0]);
+    vs_memory_arena_free(&arena, &allocations[1]);
+
+    relocations = 0;
+    CHECK(vs_memory_defrag_init(&defrag, &arena, transfer_queue, assignments[1].family_index,
+                                (vs_memory_defrag_info){ .release_delay = 1, .wrapper = &wrapper, .relocation_callback = _test_relocate, .user_data = &relocations }));
+    uint64_t submit_calls = vs_mock_submit_stats_get()->submit_calls;
+    CHECK(vs_memory_defrag_step(&defrag) && vs_memory_defrag_step(&defrag) && relocations == 0);
+    CHECK(vs_mock_submit_stats_get()->submit_calls == submit_calls);
+    uint32_t drained = 0;
+    CHECK(vs_queue_drain(&wrapper, &drained) == VK_SUCCESS && drained == 1);
+    CHECK(vs_memory_defrag_step(&defrag) && relocations == 1 && allocations[31].block == allocations[2].block);
+    vs_memory_defrag_destroy(&defrag);
+    vs_memory_arena_destroy(&arena);
+    CHECK(mem->live_allocations == 0);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Upload ring
+
+bool
+test_upload_ring(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    VkQueue             graphics_queue, transfer_queue;
+    vs_queue_assignment assignments[2];
+    vs_queue_request    requests[] =
+    {
+        { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &graphics_queue },
+        { .required_flags = VK_QUEUE_TRANSFER_BIT, .destination = &transfer_queue },
+    };
+    vs_memory_arena arena;
+    VkDevice        device = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 2, .queue_requests = requests, .out_assignments = assignments, .out_memory_arena = &arena },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE && assignments[0].family_index != assignments[1].family_index);
+
+    // The staging memory is not coherent, so that writes are flushed
+    arena.policy.memory_properties.memoryTypes[1].propertyFlags &= ~VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    vs_upload_ring ring;
+    CHECK( vs_upload_ring_init(&ring, &arena, (vs_upload_ring_info){
+        .size                  = 64 << 10,
+        .queue                 = transfer_queue,
+        .queue_family_index    = assignments[1].family_index,
+        .consumer_family_index = assignments[0].family_index,
+    }) );
+    CHECK(!ring.coherent);
+
+    VkBuffer             buffer;
+    VkBufferCreateInfo   buffer_create_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = 64 << 10 };
+    vs_memory_request    request            = { .requirements = { .size = 64 << 10, .alignment = 256, .memoryTypeBits = ~0u } };
+    vs_memory_allocation allocation;
+    CHECK(vkCreateBuffer(device, &buffer_create_info, NULL, &buffer) == VK_SUCCESS && vs_memory_arena_allocate(&arena, &request, &allocation) );
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+
+    // Small uploads to a buffer are merged into one copy, released along with an image to the consumer family
+    const vs_mock_memory_stats *mem = vs_mock_memory_stats_get();
+    uint32_t data[16];
+    for(uint32_t i = 0; i < 100; i++)
+    {
+        for(uint32_t j = 0; j < 16; j++)
+        {
+            data[j] = i * 16 + j;
+        }
+        CHECK(vs_upload_ring_buffer(&ring, buffer, i * sizeof(data), data, sizeof(data) ) );
+    }
+    VkBufferImageCopy region = { .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }, .imageExtent = { 16, 16, 1 } };
+    uint8_t           texels[16 * 16 * 4] = { 0 };
+    CHECK(vs_upload_ring_image(&ring, (VkImage)(uintptr_t)0x1234, &region, 4, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texels, sizeof(texels) ) );
+
+    uint64_t value = 0;
+    CHECK(vs_upload_ring_flush(&ring, &value) && value == 1 && vs_upload_ring_completed_value(&ring) == 1);
+    CHECK(ring.stats.uploads == 101 && ring.stats.copy_commands == 2 && ring.stats.flushes == 1);
+    CHECK(mem->copy_regions == 100 && mem->image_copy_regions == 1 && mem->flushed_ranges == 1);
+    CHECK(mem->buffer_barriers == 1 && mem->image_barriers == 2 && mem->ownership_transfers == 2);
+
+    void *mapped = NULL;
+    vkMapMemory(device, allocation.memory, allocation.offset, 64 << 10, 0, &mapped);
+    CHECK( ( (uint32_t *)mapped )[0] == 0 && ( (uint32_t *)mapped )[1599] == 1599 );
+
+    VkCommandBuffer consumer;
+    VkCommandBufferAllocateInfo allocate_info = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, .commandBufferCount = 1 };
+    vkAllocateCommandBuffers(device, &allocate_info, &consumer);
+    vs_upload_ring_record_acquire(&ring, consumer);
+    CHECK(mem->ownership_transfers == 4);
+
+    // Nothing to flush
+    CHECK(vs_upload_ring_flush(&ring, &value) && value == 1 && ring.stats.flushes == 1);
+
+    // The ring space is reused once the GPU is done with it
+    static uint8_t large[24 << 10];
+    vs_mock_set_gpu_paused(true);
+    CHECK(vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) && vs_upload_ring_flush(&ring, &value) && value == 2);
+    CHECK(vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) && vs_upload_ring_flush(&ring, &value) && value == 3);
+    CHECK(!vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) );
+    CHECK(vs_upload_ring_completed_value(&ring) == 1);
+    vs_mock_set_gpu_paused(false);
+    CHECK(vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) && vs_upload_ring_flush(&ring, &value) && value == 4);
+
+    // Too many flushes in flight wait for the oldest one
+    vs_mock_set_gpu_paused(true);
+    for(uint32_t i = 0; i < VS_UPLOAD_RING_FRAMES + 1; i++)
+    {
+        CHECK(vs_upload_ring_buffer(&ring, buffer, 0, data, sizeof(data) ) && vs_upload_ring_flush(&ring, NULL) );
+    }
+    CHECK(ring.stats.stalls == 1);
+    vs_mock_set_gpu_paused(false);
+
+    // A batch holding as many releases as it can refuses the next copy to another buffer, which fits once flushed
+    VkBuffer other;
+    bool     batch_full = true;
+    CHECK(vkCreateBuffer(device, &buffer_create_info, NULL, &other) == VK_SUCCESS);
+    vkBindBufferMemory(device, other, allocation.memory, allocation.offset);
+    for(uint32_t i = 0; i < VS_UPLOAD_RING_MAX_BARRIERS; i++)
+    {
+        CHECK(vs_upload_ring_copy(&ring, buffer, 0, i % 2 ? buffer : other, 64, 16, &batch_full) && !batch_full);
+    }
+    CHECK(!vs_upload_ring_copy(&ring, buffer, 0, other, 64, 16, &batch_full) && batch_full);
+    CHECK(vs_upload_ring_flush(&ring, NULL) && vs_upload_ring_copy(&ring, buffer, 0, other, 64, 16, &batch_full) && !batch_full);
+    CHECK(vs_upload_ring_flush(&ring, NULL) );
+    vkDestroyBuffer(device, other, NULL);
+    vs_upload_ring_destroy(&ring);
+
+    // Completion read with several flushes in flight only releases the space of the completed ones
+    CHECK( vs_upload_ring_init(&ring, &arena, (vs_upload_ring_info){ .size = 64 << 10, .queue = transfer_queue, .queue_family_index = assignments[1].family_index }) );
+    CHECK(vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) && vs_upload_ring_flush(&ring, &value) && value == 1);
+    vs_mock_set_gpu_paused(true);
+    CHECK(vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) && vs_upload_ring_flush(&ring, &value) && value == 2);
+    CHECK(vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) && vs_upload_ring_flush(&ring, &value) && value == 3);
+    CHECK(!vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) );
+    CHECK(vs_upload_ring_completed_value(&ring) == 1 && ring.released_value == 1);
+    vs_mock_set_gpu_paused(false);
+    CHECK(vs_upload_ring_buffer(&ring, buffer, 0, large, sizeof(large) ) && vs_upload_ring_flush(&ring, &value) && value == 4);
+
+    // Texel blocks of 12 bytes are not a power of two, their copies are still aligned to them within the staging buffer
+    float             rgb[4 * 4 * 3];
+    VkBufferImageCopy rgb_region = { .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }, .imageExtent = { 4, 4, 1 } };
+    for(uint32_t i = 0; i < 4 * 4 * 3; i++)
+    {
+        rgb[i] = (float)i;
+    }
+    CHECK(vs_upload_ring_buffer(&ring, buffer, 0, data, 20) );
+    CHECK(vs_upload_ring_image(&ring, (VkImage)(uintptr_t)0x1234, &rgb_region, 12, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, rgb, sizeof(rgb) ) );
+    CHECK(mem->image_copy_offset % 12 == 0);
+    CHECK(memcmp( (char *)ring.staging.allocation.mapped + mem->image_copy_offset, rgb, sizeof(rgb) ) == 0);
+    CHECK(vs_upload_ring_flush(&ring, NULL) );
+
+    vs_upload_ring_destroy(&ring);
+    vkDestroyBuffer(device, buffer, NULL);
+    vs_memory_arena_free(&arena, &allocation);
+    vs_memory_arena_destroy(&arena);
+    CHECK(mem->live_allocations == 0);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## File buffers
+
+bool
+test_file_buffer(void)
+{
+    const char *path = "/tmp/cvkstart_test_file.bin";
+    static uint8_t content[100000];
+    for(uint32_t i = 0; i < sizeof(content); i++)
+    {
+        content[i] = (uint8_t)(i * 7 + 1);
+    }
+    FILE *f = fopen(path, "wb");
+    CHECK(f != NULL && fwrite(content, 1, sizeof(content), f) == sizeof(content) );
+    fclose(f);
+
+    static const char *host_extensions[] = { "VK_EXT_external_memory_host" };
+    vs_mock_reset();
+    vs_mock_physical_device *plain = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    vs_mock_physical_device *host  = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    host->extension_count                     = 1;
+    host->extensions                          = host_extensions;
+    host->min_imported_host_pointer_alignment = 64 << 10;
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+
+    // The device supporting the extension is preferred, and it is only enabled where supported
+    char            *optional_extensions[] = { "VK_EXT_external_memory_host", "VK_EXT_unknown" };
+    bool             enabled[2];
+    VkQueue          queue;
+    vs_queue_request request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    CHECK( vs_select_physical_device_info( (vs_physical_device_selector){ .preferred_extension_count = 1, .preferred_extensions = optional_extensions },
+                                           instance, &_test_info ) );
+    CHECK(_test_info.physical_device == (VkPhysicalDevice)host);
+
+    vs_memory_arena arena;
+    VkDevice        device = vs_device_create(
+        (VkPhysicalDevice)host,
+        (vs_device_builder){
+            .queue_request_count      = 1,
+            .queue_requests           = &request,
+            .optional_extension_count = 2,
+            .optional_extensions      = optional_extensions,
+            .out_optional_enabled     = enabled,
+            .physical_device_info     = &_test_info,
+            .out_memory_arena         = &arena,
+        },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE && enabled[0] && !enabled[1] && vs_mock_last_device_creation()->enabled_extension_count == 1);
+    CHECK(arena.info.min_imported_host_pointer_alignment == 64 << 10 && arena.info.get_memory_host_pointer_properties != NULL);
+
+    // The mapping is imported as is, aligned and padded with zeros
+    const vs_mock_memory_stats *mem = vs_mock_memory_stats_get();
+    vs_file_buffer              file;
+    CHECK(vs_file_buffer_open(&arena, path, 0, &file) );
+    CHECK(file.imported && file.size == sizeof(content) && mem->imported_allocations == 1);
+    CHECK( (uintptr_t)file.data % (64 << 10) == 0 && file.mapping_size == 128 << 10 );
+    CHECK(memcmp(file.data, content, sizeof(content) ) == 0 && ( (const uint8_t *)file.data )[file.mapping_size - 1] == 0);
+
+    // The GPU reads the file straight from the mapping
+    VkBuffer             buffer;
+    VkBufferCreateInfo   buffer_create_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = sizeof(content) };
+    vs_memory_request    memory_request     = { .requirements = { .size = sizeof(content), .alignment = 256, .memoryTypeBits = ~0u } };
+    vs_memory_allocation allocation;
+    CHECK(vkCreateBuffer(device, &buffer_create_info, NULL, &buffer) == VK_SUCCESS && vs_memory_arena_allocate(&arena, &memory_request, &allocation) );
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    vkCmdCopyBuffer(VK_NULL_HANDLE, file.buffer, buffer, 1, &(VkBufferCopy){ .size = sizeof(content) });
+    void *mapped = NULL;
+    vkMapMemory(device, allocation.memory, allocation.offset, sizeof(content), 0, &mapped);
+    CHECK(memcmp(mapped, content, sizeof(content) ) == 0);
+    vkDestroyBuffer(device, buffer, NULL);
+    vs_memory_arena_free(&arena, &allocation);
+
+    vs_file_buffer_close(&arena, &file);
+    CHECK(file.buffer == VK_NULL_HANDLE && !vs_file_buffer_open(&arena, "/tmp/cvkstart_test_missing.bin", 0, &file) );
+    vs_memory_arena_destroy(&arena);
+    CHECK(mem->live_allocations == 0);
+    vs_device_destroy(device, instance);
+
+    // Without the extension, the file is copied in host visible memory
+    device = vs_device_create(
+        (VkPhysicalDevice)plain,
+        (vs_device_builder){
+            .queue_request_count      = 1,
+            .queue_requests           = &request,
+            .optional_extension_count = 2,
+            .optional_extensions      = optional_extensions,
+            .out_optional_enabled     = enabled,
+            .out_memory_arena         = &arena,
+        },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE && !enabled[0] && !enabled[1] && arena.info.get_memory_host_pointer_properties == NULL);
+    CHECK(vs_file_buffer_open(&arena, path, 0, &file) );
+    CHECK(!file.imported && file.size == sizeof(content) && mem->imported_allocations == 1);
+    CHECK(memcmp(file.data, content, sizeof(content) ) == 0);
+    vs_file_buffer_close(&arena, &file);
+    vs_memory_arena_destroy(&arena);
+    CHECK(mem->live_allocations == 0);
+
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    unlink(path);
+    return true;
+}
+
+// ## Streaming loader
+
+bool
+test_stream_loader(void)
+{
+    const char     *path = "/tmp/cvkstart_test_stream.bin";
+    static uint8_t  content[(1 << 20) + 123];
+    for(uint32_t i = 0; i < sizeof(content); i++)
+    {
+        content[i] = (uint8_t)(i * 13 + (i >> 12) );
+    }
+    FILE *f = fopen(path, "wb");
+    CHECK(f != NULL && fwrite(content, 1, sizeof(content), f) == sizeof(content) );
+    fclose(f);
+
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    VkQueue             queue;
+    vs_queue_assignment assignment;
+    vs_queue_request    request = { .required_flags = VK_QUEUE_TRANSFER_BIT, .destination = &queue };
+    vs_memory_arena     arena;
+    VkDevice            device  = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_assignments = &assignment, .out_memory_arena = &arena },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+
+    vs_upload_ring ring;
+    CHECK( vs_upload_ring_init(&ring, &arena, (vs_upload_ring_info){ .size = 64 << 10, .queue = queue, .queue_family_index = assignment.family_index }) );
+
+    VkBuffer             buffer;
+    VkBufferCreateInfo   buffer_create_info = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = 2 << 20 };
+    vs_memory_request    memory_request     = { .requirements = { .size = 2 << 20, .alignment = 256, .memoryTypeBits = ~0u } };
+    vs_memory_allocation allocation;
+    CHECK(vkCreateBuffer(device, &buffer_create_info, NULL, &buffer) == VK_SUCCESS && vs_memory_arena_allocate(&arena, &memory_request, &allocation) );
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    uint8_t *mapped = NULL;
+    vkMapMemory(device, allocation.memory, allocation.offset, 2 << 20, 0, (void **)&mapped);
+
+    // io_uring may be unavailable (or forbidden) here, the second pass always uses the threads
+    for(uint32_t pass = 0; pass < 2; pass++)
+    {
+        vs_stream_loader loader;
+        CHECK( vs_stream_loader_init(&loader, &ring, (vs_stream_loader_info){
+            .queue_depth      = 8,
+            .chunk_size       = 64 << 10,
+            .direct_io        = true,
+            .disable_io_uring = pass == 1,
+        }) );
+        CHECK(pass == 0 || !loader.io_uring);
+        CHECK( (uintptr_t)loader.staging.mapped % VS_STREAM_DIRECT_ALIGNMENT == 0 && loader.info.direct_io);
+
+        // The whole file, and an unaligned range past the end of it in the buffer
+        vs_stream_file file;
+        memset(mapped, 0, 2 << 20);
+        CHECK(vs_stream_file_open(&loader, path, &file) );
+        CHECK(vs_stream_loader_read(&loader, &file, 0, sizeof(content), buffer, 0) );
+        CHECK(vs_stream_loader_read(&loader, &file, 4097, 100000, buffer, 3 << 19) );
+        uint64_t value = 0;
+        CHECK(vs_stream_loader_finish(&loader, &value) && value == ring.flushed_value);
+        CHECK(memcmp(mapped, content, sizeof(content) ) == 0);
+        CHECK(memcmp(mapped + (3 << 19), content + 4097, 100000) == 0);
+
+        // 17 chunks for the file and 2 for the range, at most as many reads in flight as chunks
+        CHECK(loader.stats.requests == 2 && loader.stats.reads == 19 && loader.stats.bytes == sizeof(content) + 100000);
+        CHECK(loader.stats.max_depth > 1 && loader.stats.max_depth <= 8 && loader.stats.errors == 0);
+        CHECK(loader.stats.direct_reads == (file.direct ? 19 : 0) );
+
+        // Reading past the end of the file fails
+        CHECK(vs_stream_loader_read(&loader, &file, sizeof(content) - 10, 100, buffer, 0) );
+        CHECK(!vs_stream_loader_finish(&loader, NULL) && loader.stats.errors == 1);
+        CHECK(vs_stream_loader_finish(&loader, NULL) );
+
+        vs_stream_file_close(&file);
+        CHECK(file.fd == -1 && !vs_stream_file_open(&loader, "/tmp/cvkstart_test_missing.bin", &file) );
+        vs_stream_loader_destroy(&loader);
+    }
+
+    vs_upload_ring_destroy(&ring);
+    vkDestroyBuffer(device, buffer, NULL);
+    vs_memory_arena_free(&arena, &allocation);
+    vs_memory_arena_destroy(&arena);
+    CHECK(vs_mock_memory_stats_get()->live_allocations == 0);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    unlink(path);
+    return true;
+}
+
+// ## Command pools
+
+bool
+test_command_pool_set(void)
+{
+    vs_mock_reset();
+    vs_mock_physical_device *dev = vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ 0 }, &instance ) );
+    VkQueue             queue;
+    vs_queue_assignment assignment;
+    vs_queue_request    request = { .required_flags = VK_QUEUE_GRAPHICS_BIT, .destination = &queue };
+    VkDevice            device  = vs_device_create(
+        (VkPhysicalDevice)dev,
+        (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request, .out_assignments = &assignment },
+        instance
+        );
+    CHECK(device != VK_NULL_HANDLE);
+
+    // A pool per thread and frame, each on its own cache lines
+    const vs_mock_command_stats *cmd = vs_mock_command_stats_get();
+    vs_command_pool_set          set;
+    CHECK( vs_command_pool_set_init(&set, (vs_command_pool_set_info){ .device = device, .queue_family_index = assignment.family_index, .thread_count = 3 }) );
+    CHECK(set.info.frame_count == VS_COMMAND_POOL_FRAMES && cmd->created_pools == 3 * VS_COMMAND_POOL_FRAMES);
+    CHECK( (uintptr_t)set.pools % 64 == 0 && sizeof(vs_command_pool) % 64 == 0 );
+    CHECK(vs_command_pool_set_register_thread(&set) == 0 && vs_command_pool_set_register_thread(&set) == 1);
+    CHECK(vs_command_pool_set_register_thread(&set) == 2 && vs_command_pool_set_register_thread(&set) == UINT32_MAX);
+
+    // Command buffers are allocated in batches, per level
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        CHECK(vs_command_pool_set_allocate(&set, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY) != VK_NULL_HANDLE);
+    }
+    CHECK(vs_command_pool_set_allocate(&set, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY) != VK_NULL_HANDLE);
+    CHECK(cmd->allocate_calls == 3 && cmd->allocated_buffers == 3 * VS_COMMAND_POOL_ALLOCATION_BATCH && cmd->pool_resets == 0);
+
+    // The pools of the other frame are used next, then the first ones are reset and their command buffers reused
+    CHECK(vs_command_pool_set_advance(&set) == 1);
+    CHECK(vs_command_pool_set_allocate(&set, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY) != VK_NULL_HANDLE && cmd->allocate_calls == 4);
+    CHECK(vs_command_pool_set_advance(&set) == 2);
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        CHECK(vs_command_pool_set_allocate(&set, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY) != VK_NULL_HANDLE);
+    }
+    CHECK(cmd->allocate_calls == 4 && cmd->pool_resets == 1 && cmd->freed_buffers == 0);
+
+    // A thread runs out of command buffers in a frame
+    for(uint32_t i = 10; i < VS_COMMAND_POOL_MAX_BUFFERS; i++)
+    {
+        CHECK(vs_command_pool_set_allocate(&set, 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY) != VK_NULL_HANDLE);
+    }
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        CHECK(vs_command_pool_set_allocate(&set, 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY) != VK_NULL_HANDLE);
+    }
+    CHECK(vs_command_pool_set_allocate(&set, 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY) == VK_NULL_HANDLE);
+
+    vs_command_pool_set_stats stats;
+    vs_command_pool_set_stats_get(&set, &stats);
+    CHECK(stats.handed_out == 22 + VS_COMMAND_POOL_MAX_BUFFERS && stats.resets == 1);
+    CHECK(stats.allocated == 4 * VS_COMMAND_POOL_ALLOCATION_BATCH + VS_COMMAND_POOL_MAX_BUFFERS);
+
+    vs_command_pool_set_destroy(&set);
+    CHECK(cmd->destroyed_pools == cmd->created_pools && set.pools == NULL);
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+// ## Trace
+
+#ifdef VS_TRACE
+
+static vs_trace _test_trace;
+
+uint32_t
+_test_trace_count(const char *name, int32_t candidate)
+{
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < _test_trace.event_count; i++)
+    {
+        count += strcmp(_test_trace.events[i].name, name) == 0 && (candidate < -1 || _test_trace.events[i].candidate == candidate);
+    }
+    return count;
+}
+
+bool
+test_trace(void)
+{
+    vs_mock_reset();
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        vs_mock_add_physical_device("Mock GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    }
+    vs_trace_reset(&_test_trace);
+
+    vs_instance instance;
+    CHECK( vs_instance_builder_build( (vs_instance_builder){ .trace = &_test_trace }, &instance ) );
+    CHECK(instance.trace == &_test_trace);
+
+    vs_queue_request request = { .required_flags = VK_QUEUE_GRAPHICS_BIT };
+    VkPhysicalDevice physical_device = vs_select_physical_device( (vs_physical_device_selector){ .required_queue_count = 1, .required_queues = &request }, instance );
+    CHECK(physical_device != VK_NULL_HANDLE);
+    VkDevice device = vs_device_create(physical_device, (vs_device_builder){ .queue_request_count = 1, .queue_requests = &request }, instance);
+    CHECK(device != VK_NULL_HANDLE);
+
+    // Phases, and every criterion on every candidate
+    CHECK(_test_trace_count("vs_instance_builder_build", -2) == 1);
+    CHECK(_test_trace_count("layer and extension checks", -2) == 1);
+    CHECK(_test_trace_count("physical device selection", -2) == 1);
+    CHECK(_test_trace_count("_vs_dev_create_queues_info", -2) == 1);
+    for(int32_t i = 0; i < 3; i++)
+    {
+        CHECK(_test_trace_count("vs_physical_device_info_query", i) == 1);
+        CHECK(_test_trace_count("_vs_phydev_crit_required_queues", i) == 1);
+    }
+    CHECK(_test_trace_count("_vs_phydev_crit_required_queues", -1) == 0);
+
+    // Vulkan calls are counted, each span gets the calls made inside of it
+    CHECK(_test_trace.dropped_count == 0 && _test_trace.vulkan_call_count > 10);
+    for(uint32_t i = 0; i < _test_trace.event_count; i++)
+    {
+        const vs_trace_event *event = &_test_trace.events[i];
+        if(strcmp(event->name, "vkCreateInstance") == 0 || strcmp(event->name, "vkCreateDevice") == 0)
+        {
+            CHECK(event->vulkan_calls == 1 && event->thread != 0);
+        }
+    }
+
+    char  *json      = NULL;
+    size_t json_size = 0;
+    FILE  *file      = open_memstream(&json, &json_size);
+    CHECK( vs_trace_write_chrome_json(&_test_trace, file) );
+    fclose(file);
+    CHECK(strncmp(json, "{\"traceEvents\":[", 16) == 0);
+    CHECK(strstr(json, "\"name\":\"vkCreateDevice\",\"cat\":\"vulkan\",\"ph\":\"X\"") != NULL);
+    CHECK(strstr(json, "\"dropped_events\":0") != NULL);
+    free(json);
+
+    vs_device_destroy(device, instance);
+    vs_instance_destroy(instance);
+    return true;
+}
+
+#endif
+
+// ## Runner
+
+typedef struct
+{
+    const char   *name;
+    bool (*func)(void);
+} test_case;
+
+#define TEST_CASE(f) { #f, f }
+
+static const test_case tests[] =
+{
+    TEST_CASE(test_query_count),
+    TEST_CASE(test_selection_cache),
+    TEST_CASE(test_name_sets),
+    TEST_CASE(test_features),
+    TEST_CASE(test_ranking),
+    TEST_CASE(test_queue_layouts),
+    TEST_CASE(test_queue_priorities),
+    TEST_CASE(test_queue_assignment_report),
+    TEST_CASE(test_queue_submission),
+    TEST_CASE(test_dispatch),
+    TEST_CASE(test_bootstrap),
+    TEST_CASE(test_debug_messenger),
+    TEST_CASE(test_validation_profiles),
+    TEST_CASE(test_format_table),
+    TEST_CASE(test_image_formats),
+    TEST_CASE(test_memory_policy),
+    TEST_CASE(test_memory_arena),
+    TEST_CASE(test_memory_defrag),
+    TEST_CASE(test_upload_ring),
+    TEST_CASE(test_file_buffer),
+    TEST_CASE(test_stream_loader),
+    TEST_CASE(test_command_pool_set),
+#ifdef VS_TRACE
+    TEST_CASE(test_trace),
+#endif
+};
+
+int
+main()
+{
+    uint32_t failed = 0;
+    for(uint32_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        bool ok = tests[i].func();
+        printf("[%s] %s\n", ok ? " OK " : "FAIL", tests[i].name);
+        failed += ok ? 0 : 1;
+    }
+
+    if(failed)
+    {
+        printf("%u test(s) failed\n", failed);
+        return 1;
+    }
+    printf("All ok\n");
+    return 0;
+}